@@ -3,28 +3,18 @@
 
 #include "ast.h"
 #include "symbol.h"
-#include <stdio.h>
-
-#define NUM_REGS 14
-
-struct register_set {
-    int overflow;
-    bool regs_used[NUM_REGS];
-};
 
 struct acx {
-    struct register_set rs;
     struct stab *st;
-    int disp_offset;
-    FILE *ofd;
+    int disp_offset; // display slots handed out so far
     bool toplevel;
     // per-function. should really be split into an fcx.
     enum subprogs current_func_type;
     int ret_assigned;
-    char *current_func_name;
-    int label;
+    ident current_func_name;
 };
 
-struct acx analyze(struct ast_program *, FILE *);
+// check the program, annotating it for codegen. span_errs on the first error.
+struct acx analyze(struct ast_program *);
 
 #endif
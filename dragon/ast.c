@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include "token.h"
 #include "util.h"
 #include "ast.h"
@@ -47,7 +48,7 @@ void print_expr(struct ast_expr *e, int indent) {
             break;
 
         case EXPR_LIT:
-            printf("LIT `%s`\n", e->lit);
+            printf("LIT `%s`\n", ident_str(e->lit));
             break;
 
         case EXPR_PATH:
@@ -126,7 +127,7 @@ void print_stmt(struct ast_stmt *s, int indent) {
 
         case STMT_FOR:
             INDENT;
-            printf("FOR `%s` STARTING AT:\n", s->foor.id);
+            printf("FOR `%s` STARTING AT:\n", ident_str(s->foor.id));
             print_expr(s->foor.start, indent+INDSZ);
             INDENT; puts("AND GOING TO:");
             print_expr(s->foor.end, indent+INDSZ);
@@ -165,7 +166,7 @@ void print_type(struct ast_type *t, int indent) {
             break;
 
         case TYPE_ARRAY:
-            printf("ARRAY [`%s` .. `%s`] OF:\n", t->array.lower, t->array.upper);
+            printf("ARRAY [`%s` .. `%s`] OF:\n", ident_str(t->array.lower), ident_str(t->array.upper));
             print_type(t->array.elt_type, indent+INDSZ);
             break;
 
@@ -175,7 +176,7 @@ void print_type(struct ast_type *t, int indent) {
             break;
 
         case TYPE_REF:
-            printf("REFERENCE `%s`", t->ref);
+            printf("REFERENCE `%s`", ident_str(t->ref));
             break;
 
         case TYPE_FUNCTION:
@@ -208,8 +209,8 @@ void print_decls(struct ast_decls *d, int indent) {
     print_type(d->type, indent+INDSZ);
     INDENT; puts("OF NAMES:");
     indent += INDSZ;
-    LFOREACH(char *name, d->names)
-        INDENT; printf("`%s`\n", name);
+    LFOREACH(void *name, d->names)
+        INDENT; printf("`%s`\n", ident_str(P_IDENT(name)));
     ENDLFOREACH;
     indent -= INDSZ;
 }
@@ -236,7 +237,7 @@ void print_path(struct ast_path *p, int indent) {
     if (p == NULL) return;
     INDENT;
     for (struct node *temp = &p->components->inner; temp; temp = temp->next) {
-        printf("%s", temp->elt);
+        printf("%s", ident_str(P_IDENT(temp->elt)));
         if (temp->next) {
             putchar('.');
         }
@@ -247,10 +248,10 @@ void print_program(struct ast_program *p, int indent) {
     if (p == NULL) return;
     INDENT;
 
-    printf("PROGRAM `%s` WITH ARGS:\n", p->name);
+    printf("PROGRAM `%s` WITH ARGS:\n", ident_str(p->name));
     indent += INDSZ;
-    LFOREACH(char *arg, p->args)
-        INDENT; printf("`%s`\n", arg);
+    LFOREACH(void *arg, p->args)
+        INDENT; printf("`%s`\n", ident_str(P_IDENT(arg)));
     ENDLFOREACH;
     indent -= INDSZ;
 
@@ -270,7 +271,7 @@ void print_program(struct ast_program *p, int indent) {
 
 void print_record_field(struct ast_record_field *f, int indent) {
     INDENT;
-    printf("FIELD `%s` WITH TYPE:\n", f->name);
+    printf("FIELD `%s` WITH TYPE:\n", ident_str(f->name));
     print_type(f->type, indent+INDSZ);
 }
 
@@ -301,7 +302,6 @@ void free_expr(struct ast_expr *e) {
             break;
 
         case EXPR_LIT:
-            D(e->lit);
             break;
 
         case EXPR_PATH:
@@ -353,7 +353,6 @@ void free_stmt(struct ast_stmt *s) {
             break;
 
         case STMT_FOR:
-            D(s->foor.id);
             free_expr(s->foor.start);
             free_expr(s->foor.end);
             free_stmt(s->foor.body);
@@ -377,8 +376,6 @@ void free_type(struct ast_type *t) {
             break;
 
         case TYPE_ARRAY:
-            D(t->array.lower);
-            D(t->array.upper);
             free_type(t->array.elt_type);
             break;
 
@@ -396,7 +393,6 @@ void free_type(struct ast_type *t) {
             break;
 
         case TYPE_REF:
-            D(t->ref);
             break;
 
         default:
@@ -422,7 +418,6 @@ void free_subprogram_decl(struct ast_subdecl *d) {
     list_free(d->decls);
     list_free(d->types);
     free_stmt(d->body);
-    D(d->name);
     D(d);
 }
 
@@ -434,7 +429,6 @@ void free_path(struct ast_path *p) {
 
 void free_program(struct ast_program *p) {
     if (p == NULL) return;
-    D(p->name);
     list_free(p->args);
     list_free(p->decls);
     list_free(p->types);
@@ -446,31 +440,149 @@ void free_program(struct ast_program *p) {
 void free_type_decl(struct ast_type_decl *t) {
     if (t == NULL) return;
 
-    D(t->name);
     free_type(t->type);
     D(t);
 }
 
 void free_record_field(struct ast_record_field *f) {
     if (f == NULL) return;
-    D(f->name);
     free_type(f->type);
     D(f);
 }
 
+/* counting, for the -t report */
+
+static void count_type(struct ast_type *t, struct ast_counts *c) {
+    if (t == NULL) return;
+    c->types++;
+    switch (t->tag) {
+        case TYPE_ARRAY:
+            count_type(t->array.elt_type, c);
+            break;
+        case TYPE_POINTER:
+            count_type(t->pointer, c);
+            break;
+        case TYPE_FUNCTION:
+            count_type(t->func.retty, c);
+            LFOREACH(struct ast_decls *d, t->func.args)
+                c->decls++;
+                count_type(d->type, c);
+            ENDLFOREACH;
+            break;
+        case TYPE_RECORD:
+            LFOREACH(struct ast_record_field *f, t->record)
+                count_type(f->type, c);
+            ENDLFOREACH;
+            break;
+        default:
+            break;
+    }
+}
+
+static void count_expr(struct ast_expr *e, struct ast_counts *c) {
+    if (e == NULL) return;
+    c->exprs++;
+    switch (e->tag) {
+        case EXPR_APP:
+            LFOREACH(struct ast_expr *a, e->apply.args)
+                count_expr(a, c);
+            ENDLFOREACH;
+            break;
+        case EXPR_BIN:
+            count_expr(e->binary.left, c);
+            count_expr(e->binary.right, c);
+            break;
+        case EXPR_DEREF:
+            count_expr(e->deref, c);
+            break;
+        case EXPR_IDX:
+            count_expr(e->idx.expr, c);
+            break;
+        case EXPR_UN:
+            count_expr(e->unary.expr, c);
+            break;
+        case EXPR_ADDROF:
+            count_expr(e->addrof, c);
+            break;
+        default:
+            break;
+    }
+}
+
+static void count_stmt(struct ast_stmt *s, struct ast_counts *c) {
+    if (s == NULL) return;
+    c->stmts++;
+    switch (s->tag) {
+        case STMT_ASSIGN:
+            count_expr(s->assign.lvalue, c);
+            count_expr(s->assign.rvalue, c);
+            break;
+        case STMT_ITE:
+            count_expr(s->ite.cond, c);
+            count_stmt(s->ite.then, c);
+            count_stmt(s->ite.elze, c);
+            break;
+        case STMT_STMTS:
+            LFOREACH(struct ast_stmt *t, s->stmts)
+                count_stmt(t, c);
+            ENDLFOREACH;
+            break;
+        case STMT_PROC:
+            LFOREACH(struct ast_expr *a, s->apply.args)
+                count_expr(a, c);
+            ENDLFOREACH;
+            break;
+        case STMT_WDO:
+            count_expr(s->wdo.cond, c);
+            count_stmt(s->wdo.body, c);
+            break;
+        case STMT_FOR:
+            count_expr(s->foor.start, c);
+            count_expr(s->foor.end, c);
+            count_stmt(s->foor.body, c);
+            break;
+    }
+}
+
+static void count_block(struct list *types, struct list *decls, struct list *subprogs,
+        struct ast_stmt *body, struct ast_counts *c) {
+    LFOREACH(struct ast_type_decl *t, types)
+        count_type(t->type, c);
+    ENDLFOREACH;
+    LFOREACH(struct ast_decls *d, decls)
+        c->decls++;
+        count_type(d->type, c);
+    ENDLFOREACH;
+    LFOREACH(struct ast_subdecl *d, subprogs)
+        c->subprogs++;
+        count_type(d->head, c);
+        count_block(d->types, d->decls, d->subprogs, d->body, c);
+    ENDLFOREACH;
+    count_stmt(body, c);
+}
+
+void count_program(struct ast_program *p, struct ast_counts *c) {
+    memset(c, 0, sizeof(*c));
+    count_block(p->types, p->decls, p->subprogs, p->body, c);
+}
+
+size_t ast_counts_total(struct ast_counts *c) {
+    return c->subprogs + c->decls + c->stmts + c->exprs + c->types;
+}
+
 /* constructors */
 
-struct ast_path *ast_path (char *comp) {
+struct ast_path *ast_path (ident comp) {
     struct ast_path *p = M(struct ast_path);
-    p->components = list_new(comp, free);
+    p->components = list_new(IDENT_P(comp), dummy_free);
     return p;
 }
 
-void ast_path_append(struct ast_path *p, char *name) {
-    list_add(p->components, name);
+void ast_path_append(struct ast_path *p, ident name) {
+    list_add(p->components, IDENT_P(name));
 }
 
-struct ast_program *ast_program(char *name, struct list *args, struct list *decls,
+struct ast_program *ast_program(ident name, struct list *args, struct list *decls,
         struct list *types, struct list *subprogs, struct ast_stmt *body) {
     struct ast_program *p = M(struct ast_program);
     p->name = name;
@@ -482,7 +594,7 @@ struct ast_program *ast_program(char *name, struct list *args, struct list *decl
     return p;
 }
 
-struct ast_subdecl *ast_subprogram_decl(struct ast_type *sig, char *name, struct list *subprogs, struct list *types,
+struct ast_subdecl *ast_subprogram_decl(struct ast_type *sig, ident name, struct list *subprogs, struct list *types,
         struct list *decls, struct ast_stmt *body) {
     struct ast_subdecl *n = M(struct ast_subdecl);
     n->head = sig;
@@ -525,7 +637,7 @@ struct ast_expr *ast_expr(int tag, ...) {
             e->idx.expr = va_arg(args, struct ast_expr *);
             break;
         case EXPR_LIT:
-            e->lit = va_arg(args, char *);
+            e->lit = va_arg(args, ident);
             break;
         case EXPR_PATH:
             e->path = va_arg(args, struct ast_path *);
@@ -559,7 +671,7 @@ struct ast_stmt *ast_stmt(int tag, ...) {
             s->assign.rvalue = va_arg(args, struct ast_expr *);
             break;
         case STMT_FOR:
-            s->foor.id = va_arg(args, char *);
+            s->foor.id = va_arg(args, ident);
             s->foor.start = va_arg(args, struct ast_expr *);
             s->foor.end = va_arg(args, struct ast_expr *);
             s->foor.body = va_arg(args, struct ast_stmt *);
@@ -599,8 +711,8 @@ struct ast_type *ast_type(int tag, ...) {
     t->tag = tag;
     switch (tag) {
         case TYPE_ARRAY:
-            t->array.lower = va_arg(args, char *);
-            t->array.upper = va_arg(args, char *);
+            t->array.lower = va_arg(args, ident);
+            t->array.upper = va_arg(args, ident);
             t->array.elt_type = va_arg(args, struct ast_type *);
             break;
         case TYPE_POINTER:
@@ -615,7 +727,7 @@ struct ast_type *ast_type(int tag, ...) {
             t->record = va_arg(args, struct list *);
             break;
         case TYPE_REF:
-            t->ref = va_arg(args, char *);
+            t->ref = va_arg(args, ident);
             break;
         case TYPE_INTEGER:
         case TYPE_REAL:
@@ -633,14 +745,14 @@ struct ast_type *ast_type(int tag, ...) {
     return t;
 }
 
-struct ast_type_decl *ast_type_decl(char *name, struct ast_type *type) {
+struct ast_type_decl *ast_type_decl(ident name, struct ast_type *type) {
     struct ast_type_decl *t = M(struct ast_type_decl);
     t->name = name;
     t->type = type;
     return t;
 }
 
-struct ast_record_field *ast_record_field(char *name, struct ast_type *type) {
+struct ast_record_field *ast_record_field(ident name, struct ast_type *type) {
     struct ast_record_field *f = M(struct ast_record_field);
     f->name = name;
     f->type = type;
@@ -46,7 +46,7 @@ enum types {
 struct ast_type {
     union {
         struct {
-            char *lower, *upper;
+            ident lower, upper;
             struct ast_type *elt_type;
         } array;
         struct {
@@ -55,14 +55,14 @@ struct ast_type {
             struct ast_type *retty; // ret ty
         } func;
         struct ast_type *pointer;
-        char *ref;
+        ident ref;
         struct list *record;
     };
     enum types tag;
 };
 
 /**
- * Declare all of the `names` to have `type`
+ * Declare all of the `names` (a list of idents) to have `type`
  */
 struct ast_decls {
     struct list *names;
@@ -70,7 +70,7 @@ struct ast_decls {
 };
 
 struct ast_type_decl {
-    char *name;
+    ident name;
     struct ast_type *type;
 };
 
@@ -93,14 +93,16 @@ struct ast_stmt {
         } wdo;
 
         struct {
-            char *id;
+            ident id;
             struct ast_expr *start, *end;
             struct ast_stmt *body;
+            struct ast_path *path; // id as a path, made by analysis
         } foor;
 
         struct {
             struct ast_path *name;
             struct list *args;
+            size_t func; // the callee's type, from analysis
         } apply;
     };
     enum stmts tag;
@@ -109,7 +111,7 @@ struct ast_stmt {
 struct ast_expr {
     union {
         struct ast_path *path;
-        char *lit;
+        ident lit;
         struct ast_expr *addrof;
         struct ast_expr *deref;
 
@@ -121,6 +123,7 @@ struct ast_expr {
         struct {
             struct ast_path *name;
             struct list *args;
+            size_t func; // the callee's type, from analysis
         } apply;
 
         struct {
@@ -134,41 +137,66 @@ struct ast_expr {
         } binary;
     };
     enum exprs tag;
+    size_t ty; // from analysis
+    // from ir_build: registers needed to evaluate it (its Sethi-Ullman
+    // number), and whether it calls anything.
+    int need;
+    bool calls;
 };
 
+/* Analysis fills in the fields marked as coming from it, resolving every name
+ * once, so codegen can work from the tree and the symbol table alone. */
+
 struct ast_subdecl {
     struct ast_type *head;
-    char *name;
+    ident name;
     struct list *decls, *subprogs, *types;
     struct ast_stmt *body;
+    // from analysis: its scope in st->scopes, how much of the frame its
+    // locals take, and the variable holding the return value.
+    size_t scope;
+    int frame_size;
+    size_t retslot;
 };
 
 struct ast_path {
+    // list of idents
     struct list *components;
+    // from analysis: the variable the first component names, whether it
+    // belongs to an enclosing subprogram (and so is reached through the
+    // display), where the field the rest name is, from its start, and the
+    // type of what the whole path names.
+    size_t var;
+    bool nonlocal;
+    int offset;
+    size_t ty;
 };
 
 struct ast_program {
-    char *name;
+    ident name;
     struct list *args, *decls, *subprogs, *types;
     struct ast_stmt *body;
+    // from analysis, as for ast_subdecl.
+    size_t scope;
+    int frame_size;
 };
 
 struct ast_record_field {
-    char *name;
+    ident name;
     struct ast_type *type;
 };
 
 struct ast_decls *ast_decls               ( struct list *, struct ast_type *);
-struct ast_subdecl *ast_subprogram_decl   ( struct ast_type *, char *, struct list *, struct list *, struct list *, struct ast_stmt *);
-struct ast_path *ast_path                 ( char *);
-struct ast_program *ast_program           ( char *, struct list *, struct list *, struct list *, struct list *, struct ast_stmt *);
+struct ast_subdecl *ast_subprogram_decl   ( struct ast_type *, ident, struct list *, struct list *, struct list *, struct ast_stmt *);
+struct ast_path *ast_path                 ( ident);
+struct ast_program *ast_program           ( ident, struct list *, struct list *, struct list *, struct list *, struct ast_stmt *);
 struct ast_expr *ast_expr                 ( int, ...);
 struct ast_stmt *ast_stmt                 ( int, ...);
 struct ast_type *ast_type                 ( int, ...);
-struct ast_type_decl *ast_type_decl       ( char *, struct ast_type *);
-struct ast_record_field *ast_record_field ( char *, struct ast_type *);
+struct ast_type_decl *ast_type_decl       ( ident, struct ast_type *);
+struct ast_record_field *ast_record_field ( ident, struct ast_type *);
 
-void ast_path_append(struct ast_path *, char *);
+void ast_path_append(struct ast_path *, ident);
 
 void print_expr            ( struct ast_expr *, int);
 void print_stmt            ( struct ast_stmt *, int);
@@ -190,6 +218,14 @@ void free_program         ( struct ast_program *);
 void free_type_decl       ( struct ast_type_decl *);
 void free_record_field    ( struct ast_record_field *);
 
+// how many of each kind of node a program has, for the -t report.
+struct ast_counts {
+    size_t subprogs, decls, stmts, exprs, types;
+};
+
+void count_program(struct ast_program *, struct ast_counts *);
+size_t ast_counts_total(struct ast_counts *);
+
 bool is_relop(int);
 
 #endif
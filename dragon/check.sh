@@ -4,6 +4,8 @@
 # $2 - the path to the compiler
 # $3 - the path to test_util
 # $4 - the target to check
+#
+# run-pass assembles with $ASM (default yasm) and links with $CC (default cc).
 
 if [ $4 = "all" ]; then
     $0 $1 $2 $3 lexer &&
@@ -12,7 +14,7 @@ if [ $4 = "all" ]; then
     $0 $1 $2 $3 compile-fail &&
     $0 $1 $2 $3 run-pass &&
     echo "All tests passed"
-    exit 0
+    exit
 fi
 
 $3 || exit
@@ -27,7 +29,7 @@ case $4 in
         for file in $1/tests/lexer/*.d; do
             declare -a failed
             $2 -ln $file > $tmp/$file.actual 2>&1
-            if not diff -u $tmp/$file.actual $file.expected; then
+            if ! diff -u $tmp/$file.actual $file.expected; then
                 echo "Test failed: $file"
                 failed+=($file)
             else
@@ -45,7 +47,7 @@ case $4 in
         for file in $1/tests/parser/*.d; do
             declare -a failed
             $2 -pN $file > $tmp/$file.actual 2>&1
-            if not diff -u $tmp/$file.actual $file.expected; then
+            if ! diff -u $tmp/$file.actual $file.expected; then
                 echo "Test failed: $file"
                 failed+=($file)
             else
@@ -60,10 +62,10 @@ case $4 in
     semantic)
         echo "Doing semantic tests..."
         mkdir -p $tmp/$1/tests/semantic
-        for file in $1/tests/semantic/*.d; do
+        for file in $1/tests/semantic/*.p; do
             declare -a failed
             $2 -C $file > $tmp/$file.actual 2>&1
-            if not diff -u $tmp/$file.actual $file.expected; then
+            if ! diff -u $tmp/$file.actual $file.expected; then
                 echo "Test failed: $file"
                 failed+=($file)
             else
@@ -71,13 +73,51 @@ case $4 in
             fi
         done
         if [ ! ${#failed[@]} = 0 ]; then
-            echo "Parser tests failed: $failed"
+            echo "Semantic tests failed: ${failed[@]}"
             status=1
         fi
         ;;
     compile-fail)
+        echo "Doing compile-fail tests..."
+        for file in $1/tests/compile-fail/*.p; do
+            declare -a failed
+            $2 $file > /dev/null 2>&1
+            # 1 is a diagnosed error. 0 is a missed one, anything else a crash.
+            if [ $? -ne 1 ]; then
+                echo "Test failed: $file"
+                failed+=($file)
+            else
+                echo "Test passed: $file"
+            fi
+        done
+        if [ ! ${#failed[@]} = 0 ]; then
+            echo "Compile-fail tests failed: ${failed[@]}"
+            status=1
+        fi
         ;;
     run-pass)
+        echo "Doing run-pass tests..."
+        asm=${ASM:-yasm}
+        cc=${CC:-cc}
+        $asm -f elf64 -o $tmp/rt.o $1/rt.s || exit 1
+        for file in $1/tests/run-pass/*.p; do
+            declare -a failed
+            name=$tmp/$(basename $file .p)
+            if $2 $file > $name.s &&
+                $asm -f elf64 -o $name.o $name.s &&
+                $cc -no-pie -o $name $name.o $tmp/rt.o &&
+                $name > $name.actual 2>&1 &&
+                diff -u $name.actual $file.expected; then
+                echo "Test passed: $file"
+            else
+                echo "Test failed: $file"
+                failed+=($file)
+            fi
+        done
+        if [ ! ${#failed[@]} = 0 ]; then
+            echo "Run-pass tests failed: ${failed[@]}"
+            status=1
+        fi
         ;;
     *)
         echo "Unrecognized test target $4"
@@ -0,0 +1,571 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "ir.h"
+#include "peep.h"
+#include "util.h"
+
+/* Lowering the IR to x86-64, with each virtual register where regalloc put
+ * it: most in registers, some in spill slots below the function's locals,
+ * and constants and frame addresses folded into the instructions using them.
+ * rax, rcx and rdx are left free for the lowering's own use. Each function's
+ * instructions are collected (see mach.h), cleaned up by the peephole pass,
+ * and only then printed as NASM.
+ *
+ * The calling convention, for our subprograms and the runtime's alike: the
+ * caller pushes the arguments left to right and pops them after the call,
+ * the result comes back in rax, and rbx, rbp, rsp and r12-r15 are preserved.
+ * The callee sets up rbp as the frame pointer, so the arguments are at rbp+16
+ * up and the locals below rbp (see stab_add_var); the callee-saved registers
+ * it uses are pushed below those. */
+
+static struct loc reg_loc(enum reg r) {
+    struct loc l = { LOC_REG, r };
+    return l;
+}
+
+static struct opnd o_none(void) {
+    struct opnd o;
+    memset(&o, 0, sizeof(o));
+    return o;
+}
+
+static struct opnd o_reg(int r, int size) {
+    struct opnd o = o_none();
+    o.kind = OPND_REG;
+    o.size = size;
+    o.reg = r;
+    return o;
+}
+
+static struct opnd o_imm(long n) {
+    struct opnd o = o_none();
+    o.kind = OPND_IMM;
+    o.imm = n;
+    return o;
+}
+
+// [base+disp], size bytes of it (or none, for lea).
+static struct opnd o_mem(int base, long disp, int size) {
+    struct opnd o = o_none();
+    o.kind = OPND_MEM;
+    o.size = size;
+    o.base = base;
+    o.index = NO_REG;
+    o.scale = 1;
+    o.disp = disp;
+    return o;
+}
+
+static struct opnd o_display(long slot) {
+    struct opnd o = o_mem(NO_REG, slot * ABI_POINTER_SIZE, 8);
+    o.sym = "display@";
+    return o;
+}
+
+// the operand for l: a register, [rbp-N], or an immediate.
+static struct opnd o_loc(struct gcx *g, struct loc l) {
+    switch (l.kind) {
+        case LOC_REG: return o_reg(l.n, 8);
+        case LOC_STACK: return o_mem(RBP, -(g->slots + 8 * (l.n + 1)), 8);
+        case LOC_CONST: return o_imm(l.n);
+        default: abort();
+    }
+}
+
+static struct minsn *put(struct gcx *g, enum mop op, struct opnd a, struct opnd b) {
+    struct minsn *i = mach_add(&g->code, op);
+    i->o[0] = a;
+    i->o[1] = b;
+    return i;
+}
+
+static struct minsn *put2(struct gcx *g, enum mop op, struct loc a, struct loc b) {
+    return put(g, op, o_loc(g, a), o_loc(g, b));
+}
+
+// where v is, ready to be an operand: an address in the frame is worked out
+// into scratch first.
+static struct loc src(struct gcx *g, int v, enum reg scratch) {
+    struct loc l = g->al.locs[v];
+    if (l.kind == LOC_FRAME) {
+        put(g, MOP_LEA, o_reg(scratch, 8), o_mem(RBP, l.n, 0));
+        return reg_loc(scratch);
+    }
+    return l;
+}
+
+// v in a register: its own, or scratch.
+static struct loc in_reg(struct gcx *g, int v, enum reg scratch) {
+    struct loc l = src(g, v, scratch);
+    if (l.kind == LOC_REG) return l;
+    put2(g, MOP_MOV, reg_loc(scratch), l);
+    return reg_loc(scratch);
+}
+
+static void emit_move(struct gcx *g, struct loc to, struct loc from) {
+    if (to.kind == from.kind && to.n == from.n) return;
+    if (to.kind == LOC_STACK && from.kind == LOC_STACK) {
+        put2(g, MOP_MOV, reg_loc(RAX), from);
+        from = reg_loc(RAX);
+    }
+    put2(g, MOP_MOV, to, from);
+}
+
+// what a load or store touches, [a + index*scale + imm]. an address in the
+// frame is rbp and an offset, and a constant index is part of the offset;
+// anything else not in a register is loaded into scratch (the address) or
+// iscratch (the index).
+static struct opnd mem_at(struct gcx *g, struct ir_insn *i, enum reg scratch, enum reg iscratch) {
+    struct loc l = g->al.locs[i->a];
+    struct opnd m;
+    if (l.kind == LOC_FRAME) m = o_mem(RBP, l.n + i->imm, i->ty == IR_I8 ? 1 : 8);
+    else m = o_mem(in_reg(g, i->a, scratch).n, i->imm, i->ty == IR_I8 ? 1 : 8);
+    if (i->index == IR_NONE) return m;
+    struct loc x = g->al.locs[i->index];
+    long disp = m.disp + x.n * i->scale;
+    if (x.kind == LOC_CONST && disp >= INT32_MIN && disp <= INT32_MAX) {
+        m.disp = disp;
+    } else {
+        m.index = in_reg(g, i->index, iscratch).n;
+        m.scale = i->scale;
+    }
+    return m;
+}
+
+static void put_jump(struct gcx *g, enum mop op, enum cc cc, int label) {
+    struct minsn *i = mach_add(&g->code, op);
+    i->cc = cc;
+    i->label = label;
+}
+
+static enum cc cc_of(enum ir_op op) {
+    switch (op) {
+        case IR_EQ: return CC_E;
+        case IR_NE: return CC_NE;
+        case IR_LT: return CC_L;
+        case IR_GT: return CC_G;
+        case IR_LE: return CC_LE;
+        case IR_GE: return CC_GE;
+        default: abort();
+    }
+}
+
+// cc with the compared operands the other way round.
+static enum cc cc_swap(enum cc cc) {
+    switch (cc) {
+        case CC_L: return CC_G;
+        case CC_G: return CC_L;
+        case CC_LE: return CC_GE;
+        case CC_GE: return CC_LE;
+        default: return cc;
+    }
+}
+
+static enum mop arith(enum ir_op op) {
+    switch (op) {
+        case IR_ADD: return MOP_ADD;
+        case IR_SUB: return MOP_SUB;
+        case IR_MUL: return MOP_IMUL;
+        case IR_AND: return MOP_AND;
+        case IR_OR: return MOP_OR;
+        default: abort();
+    }
+}
+
+// d = a op b, two-address: in d's register if it has one b isn't in, and in
+// rax otherwise.
+static void gen_arith(struct gcx *g, struct ir_insn *i) {
+    struct loc d = g->al.locs[i->dst];
+    struct loc a = src(g, i->a, RCX), b = src(g, i->b, RDX);
+    if (i->op != IR_SUB && d.kind == LOC_REG && b.kind == LOC_REG && b.n == d.n) {
+        struct loc t = a;
+        a = b;
+        b = t;
+    }
+    struct loc r = d.kind == LOC_REG && !(b.kind == LOC_REG && b.n == d.n) ? d : reg_loc(RAX);
+    emit_move(g, r, a);
+    if (i->op == IR_MUL && b.kind == LOC_CONST) {
+        // imul only takes an immediate in its three-operand form.
+        put2(g, MOP_IMUL, r, r)->o[2] = o_imm(b.n);
+    } else {
+        put2(g, arith(i->op), r, b);
+    }
+    emit_move(g, d, r);
+}
+
+static void shift(struct gcx *g, enum mop op, enum reg r, int n) {
+    put(g, op, o_reg(r, 8), o_imm(n));
+}
+
+// k if n is 2^k, or -1.
+static int log2_exact(unsigned long n) {
+    if (n == 0 || (n & (n - 1)) != 0) return -1;
+    int k = 0;
+    while (n >>= 1) k++;
+    return k;
+}
+
+// the multiplier and shift that divide by d >= 3 (Hacker's Delight, 10-1):
+// the high half of mul * x, plus x if mul came out negative, shifted right.
+static void magic(unsigned long d, long *mul, int *shift) {
+    const unsigned long two63 = 1ul << 63;
+    unsigned long anc = two63 - 1 - two63 % d;
+    unsigned long q1 = two63 / anc, r1 = two63 - q1 * anc;
+    unsigned long q2 = two63 / d, r2 = two63 - q2 * d, delta;
+    int p = 63;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= d) {
+            q2++;
+            r2 -= d;
+        }
+        delta = d - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    *mul = (long) (q2 + 1);
+    *shift = p - 64;
+}
+
+// x div c or x mod c, c a constant other than 0 and -1 (whose idiv traps),
+// without an idiv: shifts for powers of two, and otherwise a multiply by c's
+// reciprocal. Both round towards zero, as idiv does, so x div -c is
+// -(x div c) and x mod -c is x mod c.
+static void gen_divmod_const(struct gcx *g, struct ir_insn *i, long c) {
+    struct loc d = g->al.locs[i->dst];
+    struct loc x = in_reg(g, i->a, RCX);
+    unsigned long ac = c < 0 ? -(unsigned long) c : (unsigned long) c;
+    int k = log2_exact(ac);
+
+    if (k >= 0) {
+        // a negative x is biased by 2^k - 1 first, so the shift rounds it up.
+        emit_move(g, reg_loc(RAX), x);
+        if (k > 1) shift(g, MOP_SAR, RAX, 63);
+        shift(g, MOP_SHR, RAX, 64 - k);
+        put2(g, MOP_ADD, reg_loc(RAX), x);
+        if (i->op == IR_DIV) {
+            shift(g, MOP_SAR, RAX, k);
+            if (c < 0) put(g, MOP_NEG, o_reg(RAX, 8), o_none());
+            emit_move(g, d, reg_loc(RAX));
+        } else {
+            // x less that, rounded down to a multiple of 2^k.
+            struct loc r = d.kind == LOC_REG ? d : reg_loc(RDX);
+            put(g, MOP_AND, o_reg(RAX, 8), o_imm(-(long) ac));
+            emit_move(g, r, x);
+            put2(g, MOP_SUB, r, reg_loc(RAX));
+            emit_move(g, d, r);
+        }
+        return;
+    }
+
+    long mul;
+    int s;
+    magic(ac, &mul, &s);
+    put(g, MOP_MOV, o_reg(RAX, 8), o_imm(mul));
+    put(g, MOP_IMUL, o_loc(g, x), o_none());
+    if (mul < 0) put2(g, MOP_ADD, reg_loc(RDX), x);
+    if (s > 0) shift(g, MOP_SAR, RDX, s);
+    // and one more for a negative x, to round up.
+    emit_move(g, reg_loc(RAX), x);
+    shift(g, MOP_SHR, RAX, 63);
+    put2(g, MOP_ADD, reg_loc(RDX), reg_loc(RAX));
+    if (i->op == IR_DIV) {
+        if (c < 0) put(g, MOP_NEG, o_reg(RDX, 8), o_none());
+        emit_move(g, d, reg_loc(RDX));
+    } else {
+        struct loc r = d.kind == LOC_REG ? d : reg_loc(RAX);
+        put(g, MOP_IMUL, o_reg(RDX, 8), o_reg(RDX, 8))->o[2] = o_imm(ac);
+        emit_move(g, r, x);
+        put2(g, MOP_SUB, r, reg_loc(RDX));
+        emit_move(g, d, r);
+    }
+}
+
+// x * c as a lea, a shift, or both, when c is 2^k times 1, 3, 5 or 9;
+// returns whether it was.
+static bool gen_mul_const(struct gcx *g, struct ir_insn *i) {
+    struct loc a = g->al.locs[i->a], b = g->al.locs[i->b];
+    int x = i->a;
+    long c;
+    if (b.kind == LOC_CONST) {
+        c = b.n;
+    } else if (a.kind == LOC_CONST) {
+        c = a.n;
+        x = i->b;
+    } else {
+        return false;
+    }
+    if (c <= 0) return false;
+    int k = 0;
+    while ((c & 1) == 0) {
+        c >>= 1;
+        k++;
+    }
+    if (c != 1 && c != 3 && c != 5 && c != 9) return false;
+
+    struct loc d = g->al.locs[i->dst];
+    struct loc r = d.kind == LOC_REG ? d : reg_loc(RAX);
+    struct loc xl = in_reg(g, x, RCX);
+    if (c > 1) {
+        // [x + x*(c-1)]
+        struct opnd m = o_mem(xl.n, 0, 0);
+        m.index = xl.n;
+        m.scale = c - 1;
+        put(g, MOP_LEA, o_loc(g, r), m);
+    } else {
+        emit_move(g, r, xl);
+    }
+    if (k > 0) shift(g, MOP_SHL, r.n, k);
+    emit_move(g, d, r);
+    return true;
+}
+
+// the callee-saved registers the function uses, in the order they're pushed.
+static const enum reg SAVED_ORDER[] = { RBX, R12, R13, R14, R15 };
+
+// after is the instruction after this one in its block, and next the block
+// laid out after this one; either may be NULL.
+static void gen_insn(struct gcx *g, struct ir_insn *i, struct ir_insn *after, struct ir_block *next) {
+    struct loc d = i->dst != IR_NONE ? g->al.locs[i->dst] : reg_loc(RAX);
+    struct loc a, b;
+    struct opnd m;
+    enum cc cc;
+    int va, vb;
+
+    switch (i->op) {
+        case IR_CONST:
+            // the small ones are put where they're used.
+            if (d.kind == LOC_CONST) break;
+            a = d.kind == LOC_REG ? d : reg_loc(RAX);
+            put(g, MOP_MOV, o_loc(g, a), o_imm(i->imm));
+            emit_move(g, d, a);
+            break;
+        case IR_MOV:
+            emit_move(g, d, src(g, i->a, RAX));
+            break;
+        case IR_MUL:
+            if (gen_mul_const(g, i)) break;
+            gen_arith(g, i);
+            break;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_AND:
+        case IR_OR:
+            gen_arith(g, i);
+            break;
+        case IR_DIV:
+        case IR_MOD:
+            b = g->al.locs[i->b];
+            if (b.kind == LOC_CONST && b.n != 0 && b.n != -1) {
+                gen_divmod_const(g, i, b.n);
+                break;
+            }
+            // integers are 8 bytes: cqo sign-extends rax into rdx.
+            emit_move(g, reg_loc(RAX), src(g, i->a, RAX));
+            b = src(g, i->b, RCX);
+            if (b.kind == LOC_CONST) b = in_reg(g, i->b, RCX);
+            put(g, MOP_CQO, o_none(), o_none());
+            put(g, MOP_IDIV, o_loc(g, b), o_none());
+            emit_move(g, d, reg_loc(i->op == IR_DIV ? RAX : RDX));
+            break;
+        case IR_NEG:
+        case IR_NOT:
+            a = d.kind == LOC_REG ? d : reg_loc(RAX);
+            emit_move(g, a, src(g, i->a, RCX));
+            if (i->op == IR_NEG) {
+                put(g, MOP_NEG, o_loc(g, a), o_none());
+            } else {
+                // booleans are 0 or 1.
+                put(g, MOP_XOR, o_loc(g, a), o_imm(1));
+            }
+            emit_move(g, d, a);
+            break;
+        case IR_EQ:
+        case IR_NE:
+        case IR_LT:
+        case IR_GT:
+        case IR_LE:
+        case IR_GE:
+            cc = cc_of(i->op);
+            va = i->a;
+            vb = i->b;
+            if (g->al.locs[va].kind == LOC_CONST && g->al.locs[vb].kind != LOC_CONST) {
+                // cmp takes an immediate second.
+                va = i->b;
+                vb = i->a;
+                cc = cc_swap(cc);
+            }
+            a = src(g, va, RCX);
+            b = src(g, vb, RDX);
+            if (a.kind == LOC_CONST || (a.kind == LOC_STACK && b.kind == LOC_STACK)) {
+                a = in_reg(g, va, RCX);
+            }
+            put2(g, MOP_CMP, a, b);
+            if (after && after->op == IR_BR && after->a == i->dst && g->uses[i->dst] == 1) {
+                // the branch is all that wants it: it jumps on the flags.
+                g->flags_cc = cc;
+                break;
+            }
+            a = d.kind == LOC_REG ? d : reg_loc(RAX);
+            put(g, MOP_SETCC, o_reg(a.n, 1), o_none())->cc = cc;
+            put(g, MOP_MOVZX, o_reg(a.n, 8), o_reg(a.n, 1));
+            emit_move(g, d, a);
+            break;
+        case IR_FRAME:
+            // put where it's used.
+            break;
+        case IR_DISPLAY:
+            a = d.kind == LOC_REG ? d : reg_loc(RAX);
+            put(g, MOP_MOV, o_loc(g, a), o_display(i->imm));
+            emit_move(g, d, a);
+            break;
+        case IR_SETDISP:
+            a = in_reg(g, i->a, RAX);
+            put(g, MOP_MOV, o_display(i->imm), o_loc(g, a));
+            break;
+        case IR_LOAD:
+            m = mem_at(g, i, RAX, RDX);
+            a = d.kind == LOC_REG ? d : reg_loc(RAX);
+            put(g, i->ty == IR_I8 ? MOP_MOVZX : MOP_MOV, o_loc(g, a), m);
+            emit_move(g, d, a);
+            break;
+        case IR_STORE:
+            m = mem_at(g, i, RAX, RDX);
+            b = src(g, i->b, RCX);
+            if (b.kind == LOC_STACK) b = in_reg(g, i->b, RCX);
+            if (b.kind == LOC_REG && i->ty == IR_I8) {
+                put(g, MOP_MOV, m, o_reg(b.n, 1));
+            } else {
+                put(g, MOP_MOV, m, o_loc(g, b));
+            }
+            break;
+        case IR_CALL:
+            for (int j = 0; j < i->nargs; j++) {
+                put(g, MOP_PUSH, o_loc(g, src(g, i->args[j], RAX)), o_none());
+            }
+            mach_add(&g->code, MOP_CALL)->sym = i->sym;
+            if (i->nargs) put(g, MOP_ADD, o_reg(RSP, 8), o_imm(8 * i->nargs));
+            if (i->dst != IR_NONE) emit_move(g, d, reg_loc(RAX));
+            break;
+        case IR_JMP:
+            if (!next || next->id != i->target) put_jump(g, MOP_JMP, 0, i->target);
+            break;
+        case IR_BR:
+            if (g->flags_cc >= 0) {
+                cc = g->flags_cc;
+                g->flags_cc = -1;
+            } else {
+                a = in_reg(g, i->a, RAX);
+                put2(g, MOP_TEST, a, a);
+                cc = CC_NE;
+            }
+            if (next && next->id == i->target) {
+                put_jump(g, MOP_JCC, cc ^ 1, i->target2);
+            } else {
+                put_jump(g, MOP_JCC, cc, i->target);
+                if (!next || next->id != i->target2) put_jump(g, MOP_JMP, 0, i->target2);
+            }
+            break;
+        case IR_RET:
+            if (i->a != IR_NONE) emit_move(g, reg_loc(RAX), src(g, i->a, RAX));
+            for (int r = 5; r-- > 0;) {
+                if (g->al.saved & (1u << SAVED_ORDER[r])) put(g, MOP_POP, o_reg(SAVED_ORDER[r], 8), o_none());
+            }
+            put(g, MOP_MOV, o_reg(RSP, 8), o_reg(RBP, 8));
+            put(g, MOP_POP, o_reg(RBP, 8), o_none());
+            mach_add(&g->code, MOP_RET);
+            break;
+        default:
+            abort();
+    }
+}
+
+static void gen_func(struct gcx *g, struct ir_func *fn) {
+    regalloc(fn, &g->al);
+    g->code.length = 0;
+
+    // the spill slots go below the locals, and rsp stays 16-byte aligned
+    // until the callee-saved registers are pushed.
+    g->slots = (fn->frame_size + 7) & ~7;
+    int frame = (g->slots + 8 * g->al.num_spills + 15) & ~15;
+
+    // how often each value's read, for the compares only a branch reads.
+    g->uses = xcalloc((fn->num_vregs + 1) * sizeof(*g->uses));
+    for (size_t b = 0; b < fn->blocks->length; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        for (size_t j = 0; j < bl->length; j++) {
+            struct ir_insn *i = &bl->insns[j];
+            if (i->a != IR_NONE) g->uses[i->a]++;
+            if (i->b != IR_NONE) g->uses[i->b]++;
+            if (i->index != IR_NONE) g->uses[i->index]++;
+            for (int k = 0; k < i->nargs; k++) g->uses[i->args[k]]++;
+        }
+    }
+    g->flags_cc = -1;
+
+    put(g, MOP_PUSH, o_reg(RBP, 8), o_none());
+    put(g, MOP_MOV, o_reg(RBP, 8), o_reg(RSP, 8));
+    put(g, MOP_SUB, o_reg(RSP, 8), o_imm(frame));
+    for (int r = 0; r < 5; r++) {
+        if (g->al.saved & (1u << SAVED_ORDER[r])) put(g, MOP_PUSH, o_reg(SAVED_ORDER[r], 8), o_none());
+    }
+
+    for (size_t b = 0; b < fn->blocks->length; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        struct ir_block *next = b + 1 < fn->blocks->length ? fn->blocks->data[b + 1] : NULL;
+        mach_add(&g->code, MOP_LABEL)->label = bl->id;
+        for (size_t i = 0; i < bl->length; i++) {
+            gen_insn(g, &bl->insns[i], i + 1 < bl->length ? &bl->insns[i + 1] : NULL, next);
+        }
+    }
+
+    peephole(&g->code, fn->num_blocks, g->peep_off, g->peep_counts);
+
+    // global so that we get symbol names. makes easier to debug.
+    emit_seal(&g->out);
+    emit_insn1(&g->out, "global", fn->name);
+    emit_str(&g->out, fn->name);
+    emit_lit(&g->out, ":\n");
+    for (size_t i = 0; i < g->code.length; i++) {
+        mach_print(&g->out, &g->code.data[i]);
+    }
+
+    D(g->uses);
+    D(g->al.locs);
+}
+
+void codegen(struct ir_program *prog, FILE *out, unsigned peep_off, long *peep_counts) {
+    struct gcx gcx;
+    struct gcx *g = &gcx;
+    emit_init(&g->out);
+    memset(&g->code, 0, sizeof(g->code));
+    g->peep_off = peep_off;
+    g->peep_counts = peep_counts;
+
+    emit_lit(&g->out, "; vim: ft=nasm\n");
+    for (size_t i = 0; i < prog->externs->length; i++) {
+        emit_insn1(&g->out, "extern", prog->externs->data[i]);
+    }
+    emit_lit(&g->out, "SECTION .bss\ndisplay@: resq ");
+    emit_int(&g->out, prog->display_slots ? prog->display_slots : 1);
+    emit_lit(&g->out, "\nSECTION .text\n");
+
+    for (size_t f = 0; f < prog->funcs->length; f++) {
+        gen_func(g, prog->funcs->data[f]);
+    }
+    D(g->code.data);
+
+    if (emit_flush(&g->out, out) != 0) {
+        span_err("couldn't write the assembly: %s", NULL, strerror(errno));
+    }
+}
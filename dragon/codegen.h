@@ -0,0 +1,27 @@
+#ifndef _CODEGEN_H
+#define _CODEGEN_H
+
+#include "emit.h"
+#include "ir.h"
+#include "mach.h"
+#include "regalloc.h"
+#include <stdio.h>
+
+/* NASM for a program's IR (see ir.h). */
+
+struct gcx {
+    struct emitter out; // flushed to the output at the end
+    int slots; // where, below rbp, the current function's spill slots start
+    struct alloc al; // the current function's
+    struct mvec code; // the current function's, until it's printed
+    int *uses; // how often each of the current function's values is read
+    int flags_cc; // what the flags hold for the branch after a compare, or -1
+    unsigned peep_off; // peephole rules turned off, 1 << rule each
+    long *peep_counts; // how often each applied
+};
+
+// write the program's assembly to out, without the peephole rules in
+// peep_off (see peep.h), adding how often each applied to peep_counts.
+void codegen(struct ir_program *, FILE *out, unsigned peep_off, long *peep_counts);
+
+#endif
@@ -1,57 +1,80 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "ast.h"
 #include "analysis.h"
+#include "codegen.h"
 #include "driver.h"
-#include "driver.h"
-#include "lexer.h"
+#include "ir.h"
+#include "opt.h"
+#include "pasprintf.h"
+#include "peep.h"
 #include "parser.tab.h"
+#include "report.h"
+#include "scanner.h"
 #include "token.h"
 
-void compile_input(char *program_source, size_t len, int options) {
+// the phases proper. span_err longjmps out of here, so this may not own
+// anything that compile_input wouldn't release. rep is NULL without -t.
+static int compile(char *program_source, size_t len, int options, FILE *out, struct report *rep) {
     void *lexer;
+    int tok;
+    YYSTYPE val;
+    YYLTYPE loc;
 
     struct ast_program *program = NULL;
 
     if (options & DUMP_TOKENS) {
         // duplicate the lexer init/destroy to not affect the later parse.
-        yylex_init(&lexer);
-        YY_BUFFER_STATE inp = yy_scan_bytes(program_source, len, lexer);
-        yy_switch_to_buffer(inp, lexer);
+        lexer = scanner_new(program_source, len);
 
-        int tok;
-        YYSTYPE val;
-        YYLTYPE loc;
         do {
             tok = yylex(&val, &loc, lexer);
             print_token(tok, &val);
-            if (tok == NUM || tok == ID) {
-                free(val.name);
-            }
         } while (tok != 0);
         puts("-- done dumping tokens --");
 
-        yy_delete_buffer(inp, lexer);
-        yylex_destroy(lexer);
+        scanner_free(lexer);
+    }
 
+    if (rep) {
+        // the parser drives the lexer, so lexing gets timed on a pass of its
+        // own. the parse phase pays for it again.
+        report_begin(rep, current_arena);
+        lexer = scanner_new(program_source, len);
+        do {
+            tok = yylex(&val, &loc, lexer);
+        } while (tok != 0);
+        scanner_free(lexer);
+        report_end(rep, "lex", current_arena);
     }
 
-    if (options & NO_PARSE) { return; }
+    if (options & NO_PARSE) { return 0; }
 
-    yylex_init(&lexer);
-    YY_BUFFER_STATE inp = yy_scan_bytes(program_source, len, lexer);
-    yy_switch_to_buffer(inp, lexer);
+    // bison's trace switch is process-wide, so main only allows -d when
+    // there's one input, and it's only ever set, never cleared.
+    if (options & TRACE_PARSE) { yydebug = 1; }
+
+    if (rep) report_begin(rep, current_arena);
+    lexer = scanner_new(program_source, len);
 
     // Phase 1: parse. This gives us a "raw AST", with the names interned, but
     // not much else guaranteed about the program beyond its syntactic
     // validity.
     if (yyparse(&program, options, lexer) != 0) {
-        free_program(program);
-        yy_delete_buffer(inp, lexer);
-        yylex_destroy(lexer);
-        return;
+        scanner_free(lexer);
+        return 1;
     }
 
-    yy_delete_buffer(inp, lexer);
-    yylex_destroy(lexer);
+    scanner_free(lexer);
+    if (rep) {
+        report_end(rep, "parse", current_arena);
+        count_program(program, &rep->ast);
+    }
 
     if (options & DUMP_AST) {
         print_program(program, 0);
@@ -60,12 +83,184 @@ void compile_input(char *program_source, size_t len, int options) {
 
 
     if (options & NO_ANALYSIS) {
-        free_program(program);
-        return;
+        return 0;
+    }
+
+    if (rep) report_begin(rep, current_arena);
+    struct acx acx = analyze(program);
+    if (rep) {
+        report_end(rep, "analysis", current_arena);
+        rep->scopes = acx.st->scopes->length;
+        rep->vars = acx.st->vars->length;
+        rep->types = acx.st->types->length;
+        rep->path_hits = acx.st->path_hits;
+        rep->path_misses = acx.st->path_misses;
+    }
+
+    // -C is a type check only.
+    if (options & NO_CODEGEN) {
+        return 0;
+    }
+
+    if (rep) report_begin(rep, current_arena);
+    struct ir_program *ir = ir_build(program, &acx);
+    if (rep) report_end(rep, "ir", current_arena);
+
+    if (rep) report_begin(rep, current_arena);
+    opt_fold(ir);
+    if (rep) report_end(rep, "opt", current_arena);
+
+    if (options & DUMP_IR) {
+        ir_print(ir);
+        puts("-- done dumping ir --");
+    }
+
+    long peep_counts[NUM_PEEP_RULES] = { 0 };
+    if (rep) report_begin(rep, current_arena);
+    codegen(ir, out, (unsigned) options >> PEEP_OFF_SHIFT, rep ? rep->peep : peep_counts);
+    if (rep) report_end(rep, "codegen", current_arena);
+    return 0;
+}
+
+int compile_input(char *program_source, size_t len, int options, FILE *out, const char *name) {
+    // tokens only carry offsets; diagnostics find their line through this.
+    struct source source;
+    source_init(&source, program_source, len);
+    source.name = name;
+    current_source = &source;
+
+    // everything the compile allocates is in the arena and released with a
+    // single reset at the end, instead of walking the AST and symbol table.
+    // that includes when span_err bails out halfway.
+    struct arena arena;
+    arena_init(&arena);
+    current_arena = &arena;
+
+    struct report report, *rep = NULL;
+    if (options & (TIME_REPORT | TIME_REPORT_JSON)) {
+        report_init(&report);
+        rep = &report;
+    }
+
+    jmp_buf bailout;
+    int status = 1;
+    current_bailout = &bailout;
+    if (setjmp(bailout) == 0) {
+        status = compile(program_source, len, options, out, rep);
     }
+    current_bailout = NULL;
 
-    struct acx acx = analyze(program, stdout);
+    if (rep) {
+        rep->idents = intern_count();
+        report_begin(rep, &arena);
+    }
+    current_arena = NULL;
+    arena_reset(&arena);
+    current_source = NULL;
+    source_free(&source);
+    // ids mean nothing outside the compile that made them.
+    intern_free();
+    if (rep) {
+        report_end(rep, "teardown", &arena);
+        report_print(rep, name, options & TIME_REPORT_JSON);
+    }
+    return status;
+}
+
+int compile_file(const char *path, int options, FILE *out, const char *name) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) goto fail;
+    off_t len = lseek(fd, 0, SEEK_END);
+    if (len == -1) goto fail_close;
+    char *data = mmap(0, (size_t)len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) goto fail_close;
+    close(fd);
+
+    int status = compile_input(data, (size_t)len, options, out, name);
+    munmap(data, (size_t)len);
+    return status;
+
+fail_close:
+    close(fd);
+fail:
+    fprintf(stderr, "error: can't read %s: %s\n", path, strerror(errno));
+    return 1;
+}
+
+// foo.p -> foo.s; anything without an extension (or already .s) gets .s added.
+static char *output_path(const char *path) {
+    char *out;
+    const char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/') || strcmp(dot, ".s") == 0) {
+        pasprintf(&out, "%s.s", path);
+    } else {
+        pasprintf(&out, "%.*s.s", (int)(dot - path), path);
+    }
+    if (!out) abort();
+    return out;
+}
+
+static int compile_to_file(const char *path, int options) {
+    char *out_path = output_path(path);
+    FILE *out = fopen(out_path, "w");
+    if (!out) {
+        fprintf(stderr, "error: can't write %s: %s\n", out_path, strerror(errno));
+        free(out_path);
+        return 1;
+    }
 
-    free_program(program);
-    stab_free(acx.st);
+    int status = compile_file(path, options, out, path);
+    if (fclose(out) != 0 && status == 0) {
+        fprintf(stderr, "error: can't write %s: %s\n", out_path, strerror(errno));
+        status = 1;
+    }
+    // don't leave half an assembly file around to be mistaken for a good one.
+    if (status != 0) unlink(out_path);
+    free(out_path);
+    return status;
+}
+
+struct batch {
+    char **paths;
+    int count;
+    int options;
+    int next; // the next path to hand out
+    int failed;
+};
+
+static void *batch_worker(void *arg) {
+    struct batch *b = arg;
+    int i;
+    while ((i = __sync_fetch_and_add(&b->next, 1)) < b->count) {
+        if (compile_to_file(b->paths[i], b->options) != 0) {
+            __sync_fetch_and_add(&b->failed, 1);
+        }
+    }
+    return NULL;
+}
+
+int compile_files(char **paths, int count, int jobs, int options) {
+    struct batch b = { paths, count, options, 0, 0 };
+    if (jobs > count) jobs = count;
+
+    pthread_t *threads = calloc(jobs, sizeof(pthread_t));
+    if (!threads) abort();
+    // the calling thread is a worker too.
+    int started = 0;
+    for (; started < jobs - 1; started++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, &b) != 0) {
+            break;
+        }
+    }
+    batch_worker(&b);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    if (b.failed) {
+        fprintf(stderr, "%d of %d inputs failed to compile\n", b.failed, count);
+        return 1;
+    }
+    return 0;
 }
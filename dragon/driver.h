@@ -1,6 +1,7 @@
 #ifndef _DRIVER_H
 #define _DRIVER_H
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #define DUMP_TOKENS (1 << 0)
@@ -9,7 +10,16 @@
 #define NO_ANALYSIS (1 << 3)
 #define NO_CODEGEN (1 << 4)
 #define DUMP_IR (1 << 5)
+#define TRACE_PARSE (1 << 6)
+#define TIME_REPORT (1 << 7)
+#define TIME_REPORT_JSON (1 << 8)
+// the peephole rules turned off (-P), rule r's bit shifted up by this.
+#define PEEP_OFF_SHIFT 12
 
-void compile_input(char *, size_t, int);
+// These return 0 on success, and nonzero if the input didn't compile.
+int compile_input(char *, size_t, int, FILE *out, const char *name);
+int compile_file(const char *path, int options, FILE *out, const char *name);
+// Compiles each path to a .s file next to it, on `jobs` threads.
+int compile_files(char **paths, int count, int jobs, int options);
 
 #endif
@@ -0,0 +1,94 @@
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "emit.h"
+#include "util.h"
+
+#define EMIT_MIN_BUFFER 4096
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+void emit_init(struct emitter *e) {
+    memset(e, 0, sizeof(*e));
+}
+
+void emit_grow(struct emitter *e, size_t need) {
+    size_t cap = e->capacity ? e->capacity * 2 : EMIT_MIN_BUFFER;
+    while (cap - e->length < need) cap *= 2;
+    e->buf = xrealloc(e->buf, e->capacity, cap);
+    e->capacity = cap;
+}
+
+void emit_seal(struct emitter *e) {
+    if (e->length == 0) return;
+    if (e->num_segs == e->segs_capacity) {
+        size_t cap = e->segs_capacity ? e->segs_capacity * 2 : 16;
+        e->segs = xrealloc(e->segs, e->segs_capacity * sizeof(struct iovec),
+                cap * sizeof(struct iovec));
+        e->segs_capacity = cap;
+    }
+    e->segs[e->num_segs].iov_base = e->buf;
+    e->segs[e->num_segs].iov_len = e->length;
+    e->num_segs++;
+    e->buf = NULL;
+    e->length = e->capacity = 0;
+}
+
+void emit_int(struct emitter *e, long n) {
+    char digits[24], *p = digits + sizeof(digits);
+    // negate as unsigned, so LONG_MIN works too.
+    unsigned long u = n < 0 ? -(unsigned long) n : (unsigned long) n;
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (n < 0) *--p = '-';
+    emit_raw(e, p, digits + sizeof(digits) - p);
+}
+
+void emit_insn1(struct emitter *e, const char *op, const char *a) {
+    emit_op(e, op);
+    emit_str(e, a);
+    emit_lit(e, "\n");
+}
+
+void emit_insn2(struct emitter *e, const char *op, const char *a, const char *b) {
+    emit_op(e, op);
+    emit_str(e, a);
+    emit_lit(e, ", ");
+    emit_str(e, b);
+    emit_lit(e, "\n");
+}
+
+int emit_flush(struct emitter *e, FILE *out) {
+    emit_seal(e);
+    // whatever went through stdio (the dumps, say) comes first.
+    if (fflush(out) != 0) return -1;
+    int fd = fileno(out);
+
+    struct iovec *segs = e->segs;
+    size_t left = e->num_segs;
+    while (left) {
+        int n = left > IOV_MAX ? IOV_MAX : (int) left;
+        ssize_t written = writev(fd, segs, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        // skip what got written, which may end partway into a segment.
+        while (left && (size_t) written >= segs->iov_len) {
+            written -= segs->iov_len;
+            segs++;
+            left--;
+        }
+        if (written) {
+            segs->iov_base = (char *) segs->iov_base + written;
+            segs->iov_len -= written;
+        }
+    }
+    e->num_segs = 0;
+    return 0;
+}
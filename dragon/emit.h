@@ -0,0 +1,65 @@
+#ifndef _EMIT_H
+#define _EMIT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/* In-memory assembly output. Code is appended to a buffer with the helpers
+ * below, which copy bytes rather than interpreting a format string, and the
+ * whole program goes out with writev once codegen is done. Each subprogram
+ * gets buffers of its own (see emit_seal), which become the writev segments,
+ * so nothing is copied to put them in order. The buffers come from M() like
+ * everything else, so a compile that bails out loses them with its arena. */
+
+struct emitter {
+    char *buf; // being appended to
+    size_t length, capacity;
+    struct iovec *segs; // finished buffers, in output order
+    size_t num_segs, segs_capacity;
+};
+
+void emit_init(struct emitter *);
+void emit_grow(struct emitter *, size_t);
+// finish the current buffer; the next append starts a new one.
+void emit_seal(struct emitter *);
+// write everything emitted so far to out. -1 on a write error.
+int emit_flush(struct emitter *, FILE *out);
+
+static inline void emit_raw(struct emitter *e, const char *s, size_t len) {
+    if (e->capacity - e->length < len) emit_grow(e, len);
+    memcpy(e->buf + e->length, s, len);
+    e->length += len;
+}
+
+// a string literal, whose length is known at compile time.
+#define emit_lit(e, s) emit_raw((e), "" s, sizeof(s) - 1)
+
+static inline void emit_str(struct emitter *e, const char *s) {
+    emit_raw(e, s, strlen(s));
+}
+
+void emit_int(struct emitter *, long);
+
+// an opcode and the space after it.
+static inline void emit_op(struct emitter *e, const char *op) {
+    emit_str(e, op);
+    emit_lit(e, " ");
+}
+
+// "op a\n" and "op a, b\n", the shape of most instructions.
+void emit_insn1(struct emitter *, const char *op, const char *a);
+void emit_insn2(struct emitter *, const char *op, const char *a, const char *b);
+
+// local labels are .L<n>.
+static inline void emit_label(struct emitter *e, int label) {
+    emit_lit(e, ".L");
+    emit_int(e, label);
+}
+
+static inline void emit_label_def(struct emitter *e, int label) {
+    emit_label(e, label);
+    emit_lit(e, ":\n");
+}
+
+#endif
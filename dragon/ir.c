@@ -0,0 +1,795 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ast.h"
+#include "ir.h"
+#include "symbol.h"
+#include "util.h"
+
+/* Building the IR. Each subprogram, nested or not, becomes a function of its
+ * own: what it reaches of its parents' frames goes through the display, which
+ * analysis has already worked out. */
+
+struct ircx {
+    struct stab *st;
+    struct ir_program *prog;
+    struct ir_func *fn;
+    struct ir_block *cur;
+};
+
+// where something is in memory: a register holding an address, and an offset.
+struct ir_addr {
+    int base;
+    int index, scale; // index may be IR_NONE
+    long off;         // which fits in a displacement
+};
+
+static int new_vreg(struct ircx *cx, enum ir_type ty) {
+    struct ir_func *fn = cx->fn;
+    if (fn->num_vregs == fn->vregs_capacity) {
+        int cap = fn->vregs_capacity ? fn->vregs_capacity * 2 : 16;
+        fn->vregs = xrealloc(fn->vregs, fn->vregs_capacity * sizeof(*fn->vregs), cap * sizeof(*fn->vregs));
+        fn->vregs_capacity = cap;
+    }
+    fn->vregs[fn->num_vregs] = ty;
+    return fn->num_vregs++;
+}
+
+// a block that's not in the layout yet; start_block puts it there.
+static struct ir_block *new_block(struct ircx *cx) {
+    struct ir_block *b = M(struct ir_block);
+    b->id = cx->fn->num_blocks++;
+    return b;
+}
+
+static void start_block(struct ircx *cx, struct ir_block *b) {
+    ptrvec_push(cx->fn->blocks, YOLO b);
+    cx->cur = b;
+}
+
+static struct ir_insn *emit(struct ircx *cx, enum ir_op op, enum ir_type ty, int dst, int a, int b, long imm) {
+    struct ir_block *bl = cx->cur;
+    if (bl->length == bl->capacity) {
+        size_t cap = bl->capacity ? bl->capacity * 2 : 8;
+        bl->insns = xrealloc(bl->insns, bl->capacity * sizeof(*bl->insns), cap * sizeof(*bl->insns));
+        bl->capacity = cap;
+    }
+    struct ir_insn *i = &bl->insns[bl->length++];
+    memset(i, 0, sizeof(*i));
+    i->op = op;
+    i->ty = ty;
+    i->dst = dst;
+    i->a = a;
+    i->b = b;
+    i->imm = imm;
+    i->index = IR_NONE;
+    i->scale = 1;
+    i->target = i->target2 = IR_NONE;
+    return i;
+}
+
+static int emit_const(struct ircx *cx, enum ir_type ty, long imm) {
+    int d = new_vreg(cx, ty);
+    emit(cx, IR_CONST, ty, d, IR_NONE, IR_NONE, imm);
+    return d;
+}
+
+static int emit_binop(struct ircx *cx, enum ir_op op, enum ir_type ty, int a, int b) {
+    int d = new_vreg(cx, ty);
+    emit(cx, op, ty, d, a, b, 0);
+    return d;
+}
+
+static int emit_load(struct ircx *cx, enum ir_type ty, struct ir_addr addr) {
+    int d = new_vreg(cx, ty);
+    struct ir_insn *i = emit(cx, IR_LOAD, ty, d, addr.base, IR_NONE, addr.off);
+    i->index = addr.index;
+    i->scale = addr.scale;
+    return d;
+}
+
+static void emit_store(struct ircx *cx, enum ir_type ty, struct ir_addr addr, int v) {
+    struct ir_insn *i = emit(cx, IR_STORE, ty, IR_NONE, addr.base, v, addr.off);
+    i->index = addr.index;
+    i->scale = addr.scale;
+}
+
+static void emit_jmp(struct ircx *cx, struct ir_block *to) {
+    emit(cx, IR_JMP, IR_VOID, IR_NONE, IR_NONE, IR_NONE, 0)->target = to->id;
+}
+
+static void emit_br(struct ircx *cx, int cond, struct ir_block *then, struct ir_block *elze) {
+    struct ir_insn *i = emit(cx, IR_BR, IR_VOID, IR_NONE, cond, IR_NONE, 0);
+    i->target = then->id;
+    i->target2 = elze->id;
+}
+
+// the IR type of a value of stab type ty.
+static enum ir_type ir_type_of(struct ircx *cx, size_t ty) {
+    switch (STAB_TYPE(cx->st, ty)->ty.tag) {
+        case TYPE_BOOLEAN:
+        case TYPE_CHAR:
+            return IR_I8;
+        case TYPE_INTEGER:
+            return IR_I64;
+        case TYPE_POINTER:
+        case TYPE_STRING:
+            return IR_PTR;
+        case TYPE_REAL:
+            span_err("reals aren't supported by codegen yet", NULL);
+            return IR_VOID;
+        case TYPE_RECORD:
+        case TYPE_ARRAY:
+            span_err("whole records and arrays can't be used as values yet", NULL);
+            return IR_VOID;
+        default:
+            span_err("value of unexpected type %d", NULL, STAB_TYPE(cx->st, ty)->ty.tag);
+            return IR_VOID;
+    }
+}
+
+// the runtime routine's symbol, noted to be declared extern.
+static const char *rt_sym(struct ircx *cx, const char *name) {
+    for (size_t i = 0; i < cx->prog->externs->length; i++) {
+        if (strcmp(cx->prog->externs->data[i], name) == 0) return name;
+    }
+    ptrvec_push(cx->prog->externs, YOLO name);
+    return name;
+}
+
+// a subprogram's symbol: its name and an @, so it can't clash with libc.
+static const char *func_sym(ident name) {
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), "%s@", ident_str(name));
+    return ident_str(intern(buf, len));
+}
+
+static int gen_call(struct ircx *cx, int dst, const char *sym, int *args, int nargs) {
+    struct ir_insn *i = emit(cx, IR_CALL, dst == IR_NONE ? IR_VOID : cx->fn->vregs[dst], dst, IR_NONE, IR_NONE, 0);
+    i->sym = sym;
+    i->args = args;
+    i->nargs = nargs;
+    return dst;
+}
+
+static int gen_expr(struct ircx *, struct ast_expr *);
+
+// what a call needs: as good as everything, since only the few callee-saved
+// registers keep values across one.
+#define CALL_NEED 16
+
+// registers to evaluate two operands, the one needing more first.
+static int need2(int l, int r) {
+    return l == r ? l + 1 : l > r ? l : r;
+}
+
+// Sethi-Ullman numbering, for e and everything under it.
+static void label(struct ast_expr *e) {
+    switch (e->tag) {
+        case EXPR_APP:
+            e->need = 0;
+            LFOREACH(struct ast_expr *arg, e->apply.args)
+                label(arg);
+                e->need = need2(e->need, arg->need);
+            ENDLFOREACH;
+            if (e->need < CALL_NEED) e->need = CALL_NEED;
+            e->calls = true;
+            break;
+        case EXPR_BIN:
+            label(e->binary.left);
+            label(e->binary.right);
+            e->need = need2(e->binary.left->need, e->binary.right->need);
+            e->calls = e->binary.left->calls || e->binary.right->calls;
+            break;
+        case EXPR_DEREF:
+            label(e->deref);
+            e->need = e->deref->need;
+            e->calls = e->deref->calls;
+            break;
+        case EXPR_IDX:
+            // and one for the array's address.
+            label(e->idx.expr);
+            e->need = need2(e->idx.expr->need, 1);
+            e->calls = e->idx.expr->calls;
+            break;
+        case EXPR_UN:
+            label(e->unary.expr);
+            e->need = e->unary.expr->need;
+            e->calls = e->unary.expr->calls;
+            break;
+        default:
+            e->need = 1;
+            e->calls = false;
+            break;
+    }
+}
+
+// whether b should be evaluated before a, which comes first in the source:
+// when it needs more registers, so fewer values wait in registers while it's
+// worked out. calls are kept in source order, as their side effects may show.
+static bool goes_first(struct ast_expr *a, struct ast_expr *b) {
+    if (!a->need) label(a);
+    if (!b->need) label(b);
+    return b->need > a->need && !(a->calls && b->calls);
+}
+
+// the register a path's variable is kept in, or IR_NONE if it's in memory.
+static int path_vreg(struct ircx *cx, struct ast_path *p) {
+    return p->nonlocal ? IR_NONE : STAB_VAR(cx->st, p->var)->vreg;
+}
+
+// home := v, for a variable kept in a register. v is usually what the last
+// instruction just worked out, which can then put it in home directly.
+static void assign_vreg(struct ircx *cx, int home, int v) {
+    struct ir_block *bl = cx->cur;
+    if (bl->length && bl->insns[bl->length - 1].dst == v && !ir_is_local(cx->fn, v)) {
+        bl->insns[bl->length - 1].dst = home;
+    } else {
+        emit(cx, IR_MOV, cx->fn->vregs[home], home, v, IR_NONE, 0);
+    }
+}
+
+// an address as a value of its own.
+static int addr_value(struct ircx *cx, struct ir_addr addr) {
+    int v = addr.base;
+    if (addr.index != IR_NONE) {
+        int scaled = addr.index;
+        if (addr.scale != 1) {
+            scaled = emit_binop(cx, IR_MUL, IR_I64, scaled, emit_const(cx, IR_I64, addr.scale));
+        }
+        v = emit_binop(cx, IR_ADD, IR_PTR, v, scaled);
+    }
+    if (addr.off != 0) {
+        v = emit_binop(cx, IR_ADD, IR_PTR, v, emit_const(cx, IR_I64, addr.off));
+    }
+    return v;
+}
+
+// where a path's storage is.
+static struct ir_addr gen_path_addr(struct ircx *cx, struct ast_path *p) {
+    struct stab_var *v = STAB_VAR(cx->st, p->var);
+    struct ir_addr addr;
+    addr.base = new_vreg(cx, IR_PTR);
+    addr.index = IR_NONE;
+    addr.scale = 1;
+    if (p->nonlocal) {
+        emit(cx, IR_DISPLAY, IR_PTR, addr.base, IR_NONE, IR_NONE, v->disp_offset);
+        addr.off = p->offset;
+    } else {
+        emit(cx, IR_FRAME, IR_PTR, addr.base, IR_NONE, IR_NONE, v->stack_base_offset);
+        addr.off = p->offset;
+    }
+    return addr;
+}
+
+// where an lvalue's storage is.
+static struct ir_addr gen_addr(struct ircx *cx, struct ast_expr *e) {
+    struct ir_addr addr;
+    struct stab_type *at;
+    long size, off;
+    int idx;
+
+    switch (e->tag) {
+        case EXPR_PATH:
+            return gen_path_addr(cx, e->path);
+        case EXPR_IDX:
+            // base + idx*size + (off - lower*size): the lower bound is folded
+            // into the offset, and sizes x86 can scale by need no multiply.
+            if (!e->need) label(e);
+            if (e->idx.expr->need > 1) {
+                idx = gen_expr(cx, e->idx.expr);
+                addr = gen_path_addr(cx, e->idx.path);
+            } else {
+                addr = gen_path_addr(cx, e->idx.path);
+                idx = gen_expr(cx, e->idx.expr);
+            }
+            at = STAB_TYPE(cx->st, e->idx.path->ty);
+            size = STAB_TYPE(cx->st, at->ty.array.elt_type)->size;
+            off = addr.off - at->ty.array.lower * size;
+            if (size == 1 || size == 2 || size == 4 || size == 8) {
+                addr.index = idx;
+                addr.scale = (int) size;
+            } else {
+                addr.index = emit_binop(cx, IR_MUL, IR_I64, idx, emit_const(cx, IR_I64, size));
+            }
+            if (off < INT32_MIN || off > INT32_MAX) {
+                addr.base = emit_binop(cx, IR_ADD, IR_PTR, addr.base, emit_const(cx, IR_I64, off));
+                off = 0;
+            }
+            addr.off = off;
+            return addr;
+        case EXPR_DEREF:
+            addr.base = gen_expr(cx, e->deref);
+            addr.index = IR_NONE;
+            addr.scale = 1;
+            addr.off = 0;
+            return addr;
+        default:
+            span_err("not an lvalue", NULL);
+            abort();
+    }
+}
+
+static void gen_magic(struct ircx *cx, int which, struct list *args) {
+    if (which == MAGIC_WRITELN || which == MAGIC_WRITE) {
+        LFOREACH(struct ast_expr *e, args)
+            const char *callit;
+            switch (e->ty) {
+                case INTEGER_TYPE_IDX: callit = "write_integer@"; break;
+                case REAL_TYPE_IDX: callit = "write_real@"; break;
+                case STRING_TYPE_IDX: callit = "write_string@"; break;
+                case BOOLEAN_TYPE_IDX: callit = "write_bool@"; break;
+                case CHAR_TYPE_IDX: callit = "write_char@"; break;
+                case VOID_TYPE_IDX: callit = "write_void@"; break;
+                default: abort();
+            }
+            int *arg = M(int);
+            *arg = gen_expr(cx, e);
+            gen_call(cx, IR_NONE, rt_sym(cx, callit), arg, 1);
+        ENDLFOREACH;
+        if (which == MAGIC_WRITELN) {
+            gen_call(cx, IR_NONE, rt_sym(cx, "write_newline@"), NULL, 0);
+        }
+    } else if (which == MAGIC_READ || which == MAGIC_READLN) {
+        LFOREACH(struct ast_expr *e, args)
+            const char *callit;
+            switch (e->ty) {
+                case INTEGER_TYPE_IDX: callit = "read_integer@"; break;
+                case REAL_TYPE_IDX: callit = "read_real@"; break;
+                case STRING_TYPE_IDX: callit = "read_string@"; break;
+                case BOOLEAN_TYPE_IDX: callit = "read_bool@"; break;
+                case CHAR_TYPE_IDX: callit = "read_char@"; break;
+                case VOID_TYPE_IDX: callit = "read_void@"; break;
+                default: abort();
+            }
+            // read into the lvalue: it gets the address.
+            struct ir_addr addr = gen_addr(cx, e);
+            int *arg = M(int);
+            *arg = addr_value(cx, addr);
+            gen_call(cx, IR_NONE, rt_sym(cx, callit), arg, 1);
+            if (which == MAGIC_READLN) {
+                gen_call(cx, IR_NONE, rt_sym(cx, "read_newline@"), NULL, 0);
+            }
+        ENDLFOREACH;
+    } else {
+        DIAG("bad magic %d!\n", which);
+        abort();
+    }
+}
+
+// the call's result, or IR_NONE for a procedure.
+static int gen_apply(struct ircx *cx, struct ast_path *p, struct list *args, size_t func) {
+    struct stab_type *pt = STAB_TYPE(cx->st, func);
+
+    if (pt->magic != 0) {
+        gen_magic(cx, pt->magic, args);
+        return IR_NONE;
+    }
+
+    // the arguments needing the most registers go first, calls in order.
+    int n = args->length;
+    int *argv = n ? xcalloc(n * sizeof(int)) : NULL;
+    struct ast_expr **argx = n ? xcalloc(n * sizeof(*argx)) : NULL;
+    int *order = n ? xcalloc(n * sizeof(int)) : NULL;
+    int i = 0;
+    LFOREACH(struct ast_expr *e, args)
+        if (!e->need) label(e);
+        argx[i] = e;
+        order[i] = i;
+        i++;
+    ENDLFOREACH;
+    for (i = 1; i < n; i++) {
+        // an insertion sort that only moves an argument past ones it should
+        // go before, so it's stable, and keeps calls in order.
+        int o = order[i], j = i;
+        while (j > 0 && goes_first(argx[order[j - 1]], argx[o])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = o;
+    }
+    for (i = 0; i < n; i++) {
+        argv[order[i]] = gen_expr(cx, argx[order[i]]);
+    }
+    D(order);
+    D(argx);
+
+    int dst = IR_NONE;
+    if (pt->ty.func.type == SUB_FUNCTION) {
+        dst = new_vreg(cx, ir_type_of(cx, pt->ty.func.retty));
+    }
+    return gen_call(cx, dst, func_sym(P_IDENT(list_last(p->components))), argv, n);
+}
+
+static enum ir_op binop(int op) {
+    switch (op) {
+        case AND: return IR_AND;
+        case OR: return IR_OR;
+        case DIV: case '/': return IR_DIV;
+        case MOD: return IR_MOD;
+        case '+': return IR_ADD;
+        case '-': return IR_SUB;
+        case '*': return IR_MUL;
+        case '=': return IR_EQ;
+        case NEQ: return IR_NE;
+        case '<': return IR_LT;
+        case '>': return IR_GT;
+        case LE: return IR_LE;
+        case GE: return IR_GE;
+        default:
+            // analysis doesn't let any others through.
+            abort();
+    }
+}
+
+static int gen_expr(struct ircx *cx, struct ast_expr *e) {
+    int v;
+
+    switch (e->tag) {
+        case EXPR_APP:
+            v = gen_apply(cx, e->apply.name, e->apply.args, e->apply.func);
+            if (v == IR_NONE) span_err("procedure used as a value", NULL);
+            return v;
+        case EXPR_BIN:
+            if (goes_first(e->binary.left, e->binary.right)) {
+                int r = gen_expr(cx, e->binary.right);
+                v = gen_expr(cx, e->binary.left);
+                return emit_binop(cx, binop(e->binary.op), ir_type_of(cx, e->ty), v, r);
+            }
+            v = gen_expr(cx, e->binary.left);
+            return emit_binop(cx, binop(e->binary.op), ir_type_of(cx, e->ty), v,
+                    gen_expr(cx, e->binary.right));
+        case EXPR_PATH:
+            if ((v = path_vreg(cx, e->path)) != IR_NONE) return v;
+            return emit_load(cx, ir_type_of(cx, e->ty), gen_addr(cx, e));
+        case EXPR_DEREF:
+        case EXPR_IDX:
+            return emit_load(cx, ir_type_of(cx, e->ty), gen_addr(cx, e));
+        case EXPR_LIT:
+            return emit_const(cx, IR_I64, atol(ident_str(e->lit)));
+        case EXPR_UN:
+            v = gen_expr(cx, e->unary.expr);
+            if (e->unary.op == '+') return v;
+            int d = new_vreg(cx, ir_type_of(cx, e->ty));
+            emit(cx, e->unary.op == NOT ? IR_NOT : IR_NEG, cx->fn->vregs[d], d, v, IR_NONE, 0);
+            return d;
+        default:
+            abort();
+    }
+}
+
+// a condition, as branches to then if it holds and elze if not: and and or
+// stop at the first operand that decides them, and not swaps the two.
+static void gen_cond(struct ircx *cx, struct ast_expr *e, struct ir_block *then, struct ir_block *elze) {
+    struct ir_block *rest;
+
+    if (e->ty == BOOLEAN_TYPE_IDX && e->tag == EXPR_BIN
+            && (e->binary.op == AND || e->binary.op == OR)) {
+        rest = new_block(cx);
+        if (e->binary.op == AND) {
+            gen_cond(cx, e->binary.left, rest, elze);
+        } else {
+            gen_cond(cx, e->binary.left, then, rest);
+        }
+        start_block(cx, rest);
+        gen_cond(cx, e->binary.right, then, elze);
+    } else if (e->tag == EXPR_UN && e->unary.op == NOT) {
+        gen_cond(cx, e->unary.expr, elze, then);
+    } else {
+        emit_br(cx, gen_expr(cx, e), then, elze);
+    }
+}
+
+static void gen_stmt(struct ircx *cx, struct ast_stmt *s) {
+    struct ir_block *head, *body, *elze, *done;
+    struct ir_addr addr;
+    int v, end, home;
+
+    if (!s) return;
+
+    switch (s->tag) {
+        case STMT_ASSIGN:
+            if (s->assign.lvalue->tag == EXPR_PATH
+                    && (home = path_vreg(cx, s->assign.lvalue->path)) != IR_NONE) {
+                assign_vreg(cx, home, gen_expr(cx, s->assign.rvalue));
+                break;
+            }
+            if (goes_first(s->assign.lvalue, s->assign.rvalue)) {
+                v = gen_expr(cx, s->assign.rvalue);
+                addr = gen_addr(cx, s->assign.lvalue);
+            } else {
+                addr = gen_addr(cx, s->assign.lvalue);
+                v = gen_expr(cx, s->assign.rvalue);
+            }
+            emit_store(cx, ir_type_of(cx, s->assign.lvalue->ty), addr, v);
+            break;
+
+        case STMT_FOR:
+            // var := start; if var <= end (evaluated once) then repeat body;
+            // var := var + 1 until var > end: one branch a time round, at the
+            // bottom, and none at the top when the bounds are constants.
+            v = gen_expr(cx, s->foor.start);
+            end = gen_expr(cx, s->foor.end);
+            if (ir_is_local(cx->fn, end)) {
+                // the body may change the variable; the bound stays.
+                int copy = new_vreg(cx, IR_I64);
+                emit(cx, IR_MOV, IR_I64, copy, end, IR_NONE, 0);
+                end = copy;
+            }
+            home = path_vreg(cx, s->foor.path);
+            if (home != IR_NONE) {
+                assign_vreg(cx, home, v);
+            } else {
+                emit_store(cx, IR_I64, gen_path_addr(cx, s->foor.path), v);
+            }
+
+            body = new_block(cx);
+            done = new_block(cx);
+            emit_br(cx, emit_binop(cx, IR_LE, IR_I8, v, end), body, done);
+
+            start_block(cx, body);
+            gen_stmt(cx, s->foor.body);
+            if (home != IR_NONE) {
+                emit(cx, IR_ADD, IR_I64, home, home, emit_const(cx, IR_I64, 1), 0);
+                v = home;
+            } else {
+                addr = gen_path_addr(cx, s->foor.path);
+                v = emit_load(cx, IR_I64, addr);
+                v = emit_binop(cx, IR_ADD, IR_I64, v, emit_const(cx, IR_I64, 1));
+                emit_store(cx, IR_I64, addr, v);
+            }
+            emit_br(cx, emit_binop(cx, IR_LE, IR_I8, v, end), body, done);
+
+            start_block(cx, done);
+            break;
+
+        case STMT_ITE:
+            body = new_block(cx);
+            elze = new_block(cx);
+            done = new_block(cx);
+            gen_cond(cx, s->ite.cond, body, elze);
+
+            start_block(cx, body);
+            gen_stmt(cx, s->ite.then);
+            emit_jmp(cx, done);
+
+            start_block(cx, elze);
+            gen_stmt(cx, s->ite.elze);
+            emit_jmp(cx, done);
+
+            start_block(cx, done);
+            break;
+
+        case STMT_PROC:
+            gen_apply(cx, s->apply.name, s->apply.args, s->apply.func);
+            break;
+
+        case STMT_STMTS:
+            LFOREACH(struct ast_stmt *s, s->stmts)
+                gen_stmt(cx, s);
+            ENDLFOREACH;
+            break;
+
+        case STMT_WDO:
+            head = new_block(cx);
+            body = new_block(cx);
+            done = new_block(cx);
+            emit_jmp(cx, head);
+
+            start_block(cx, head);
+            gen_cond(cx, s->wdo.cond, body, done);
+
+            start_block(cx, body);
+            gen_stmt(cx, s->wdo.body);
+            emit_jmp(cx, head);
+
+            start_block(cx, done);
+            break;
+
+        default:
+            abort();
+    }
+}
+
+static struct ir_func *new_func(struct ircx *cx, const char *name, int frame_size) {
+    struct ir_func *fn = M(struct ir_func);
+    fn->name = name;
+    fn->blocks = ptrvec_wcap(8, CB dummy_free);
+    fn->frame_size = frame_size;
+    cx->fn = fn;
+    ptrvec_push(cx->prog->funcs, YOLO fn);
+    start_block(cx, new_block(cx));
+    return fn;
+}
+
+// the scope's scalar variables that only its own code reaches get registers
+// of their own, which the arguments among them are loaded into.
+static void promote_locals(struct ircx *cx, struct stab_scope *sc) {
+    for (size_t i = 0; i < sc->vars->length; i++) {
+        struct stab_var *v = STAB_VAR(cx->st, (size_t) sc->vars->data[i]);
+        if (v->captured || v->addressed) continue;
+        switch (STAB_TYPE(cx->st, v->type)->ty.tag) {
+            case TYPE_BOOLEAN:
+            case TYPE_CHAR:
+            case TYPE_INTEGER:
+            case TYPE_POINTER:
+                v->vreg = new_vreg(cx, ir_type_of(cx, v->type));
+                break;
+            default:
+                break;
+        }
+    }
+    cx->fn->num_locals = cx->fn->num_vregs;
+
+    for (size_t i = 0; i < sc->vars->length; i++) {
+        struct stab_var *v = STAB_VAR(cx->st, (size_t) sc->vars->data[i]);
+        if (v->vreg == IR_NONE || v->stack_base_offset < 0) continue;
+        int a = new_vreg(cx, IR_PTR);
+        emit(cx, IR_FRAME, IR_PTR, a, IR_NONE, IR_NONE, v->stack_base_offset);
+        emit(cx, IR_LOAD, cx->fn->vregs[v->vreg], v->vreg, a, IR_NONE, 0);
+    }
+}
+
+// point the display at this activation's captured locals, returning what
+// was there before, one register each.
+static int *enter_display(struct ircx *cx, struct stab_scope *sc, bool save) {
+    int *saved = sc->vars->length ? xcalloc(sc->vars->length * sizeof(int)) : NULL;
+    for (size_t i = 0; i < sc->vars->length; i++) {
+        struct stab_var *v = STAB_VAR(cx->st, (size_t) sc->vars->data[i]);
+        if (!v->captured) continue;
+        if (save) {
+            saved[i] = new_vreg(cx, IR_PTR);
+            emit(cx, IR_DISPLAY, IR_PTR, saved[i], IR_NONE, IR_NONE, v->disp_offset);
+        }
+        int a = new_vreg(cx, IR_PTR);
+        emit(cx, IR_FRAME, IR_PTR, a, IR_NONE, IR_NONE, v->stack_base_offset);
+        emit(cx, IR_SETDISP, IR_VOID, IR_NONE, a, IR_NONE, v->disp_offset);
+    }
+    return saved;
+}
+
+static void leave_display(struct ircx *cx, struct stab_scope *sc, int *saved) {
+    for (size_t i = sc->vars->length; i-- > 0;) {
+        struct stab_var *v = STAB_VAR(cx->st, (size_t) sc->vars->data[i]);
+        if (!v->captured) continue;
+        emit(cx, IR_SETDISP, IR_VOID, IR_NONE, saved[i], IR_NONE, v->disp_offset);
+    }
+}
+
+static void gen_subprog(struct ircx *cx, struct ast_subdecl *s) {
+    // nested subprograms are functions like any other.
+    LFOREACH(struct ast_subdecl *d, s->subprogs)
+        gen_subprog(cx, d);
+    ENDLFOREACH;
+
+    new_func(cx, func_sym(s->name), s->frame_size);
+    struct stab_scope *sc = cx->st->scopes->data[s->scope];
+    promote_locals(cx, sc);
+    int *saved = enter_display(cx, sc, true);
+
+    gen_stmt(cx, s->body);
+
+    leave_display(cx, sc, saved);
+    struct stab_var *retslot = STAB_VAR(cx->st, s->retslot);
+    if (s->head->func.type == SUB_FUNCTION && retslot->vreg != IR_NONE) {
+        emit(cx, IR_RET, cx->fn->vregs[retslot->vreg], IR_NONE, retslot->vreg, IR_NONE, 0);
+    } else if (s->head->func.type == SUB_FUNCTION) {
+        struct ast_path ret;
+        memset(&ret, 0, sizeof(ret));
+        ret.var = s->retslot;
+        size_t ty = retslot->type;
+        int v = emit_load(cx, ir_type_of(cx, ty), gen_path_addr(cx, &ret));
+        emit(cx, IR_RET, cx->fn->vregs[v], IR_NONE, v, IR_NONE, 0);
+    } else {
+        emit(cx, IR_RET, IR_VOID, IR_NONE, IR_NONE, IR_NONE, 0);
+    }
+}
+
+struct ir_program *ir_build(struct ast_program *prog, struct acx *acx) {
+    struct ircx cx_;
+    struct ircx *cx = &cx_;
+    cx->st = acx->st;
+    cx->prog = M(struct ir_program);
+    cx->prog->funcs = ptrvec_wcap(8, CB dummy_free);
+    cx->prog->externs = ptrvec_wcap(4, CB dummy_free);
+    cx->prog->display_slots = acx->disp_offset;
+
+    LFOREACH(struct ast_subdecl *d, prog->subprogs)
+        gen_subprog(cx, d);
+    ENDLFOREACH;
+
+    // the program body is main, which nothing calls back into, so it has no
+    // display to restore.
+    struct ir_func *fn = new_func(cx, "main", prog->frame_size);
+    fn->main = true;
+    promote_locals(cx, cx->st->scopes->data[prog->scope]);
+    enter_display(cx, cx->st->scopes->data[prog->scope], false);
+    gen_stmt(cx, prog->body);
+    int zero = emit_const(cx, IR_I64, 0);
+    emit(cx, IR_RET, IR_I64, IR_NONE, zero, IR_NONE, 0);
+
+    return cx->prog;
+}
+
+static const char *OP_NAMES[NUM_IR_OPS] = {
+    [IR_CONST] = "const", [IR_MOV] = "mov", [IR_ADD] = "add", [IR_SUB] = "sub",
+    [IR_MUL] = "mul", [IR_DIV] = "div", [IR_MOD] = "mod", [IR_AND] = "and",
+    [IR_OR] = "or", [IR_NEG] = "neg", [IR_NOT] = "not", [IR_EQ] = "eq",
+    [IR_NE] = "ne", [IR_LT] = "lt", [IR_GT] = "gt", [IR_LE] = "le",
+    [IR_GE] = "ge", [IR_FRAME] = "frame", [IR_DISPLAY] = "display",
+    [IR_SETDISP] = "setdisp", [IR_LOAD] = "load", [IR_STORE] = "store",
+    [IR_CALL] = "call", [IR_JMP] = "jmp", [IR_BR] = "br", [IR_RET] = "ret",
+};
+
+static const char *TYPE_NAMES[] = {
+    [IR_VOID] = "void", [IR_I8] = "i8", [IR_I64] = "i64", [IR_PTR] = "ptr",
+};
+
+static void print_addr(struct ir_insn *i) {
+    printf("[v%d", i->a);
+    if (i->index != IR_NONE) {
+        printf("+v%d", i->index);
+        if (i->scale != 1) printf("*%d", i->scale);
+    }
+    printf("%+ld]", i->imm);
+}
+
+static void print_insn(struct ir_func *fn, struct ir_insn *i) {
+    INDENTE(INDSZ);
+    if (i->dst != IR_NONE) {
+        printf("v%d:%s = ", i->dst, TYPE_NAMES[fn->vregs[i->dst]]);
+    }
+    printf("%s", OP_NAMES[i->op]);
+    switch (i->op) {
+        case IR_CONST:
+        case IR_FRAME:
+        case IR_DISPLAY:
+            printf(" %ld", i->imm);
+            break;
+        case IR_SETDISP:
+            printf(" %ld, v%d", i->imm, i->a);
+            break;
+        case IR_LOAD:
+            printf(".%s ", TYPE_NAMES[i->ty]);
+            print_addr(i);
+            break;
+        case IR_STORE:
+            printf(".%s ", TYPE_NAMES[i->ty]);
+            print_addr(i);
+            printf(", v%d", i->b);
+            break;
+        case IR_CALL:
+            printf(" %s(", i->sym);
+            for (int j = 0; j < i->nargs; j++) {
+                printf("%sv%d", j ? ", " : "", i->args[j]);
+            }
+            printf(")");
+            break;
+        case IR_JMP:
+            printf(" b%d", i->target);
+            break;
+        case IR_BR:
+            printf(" v%d, b%d, b%d", i->a, i->target, i->target2);
+            break;
+        default:
+            if (i->a != IR_NONE) printf(" v%d", i->a);
+            if (i->b != IR_NONE) printf(", v%d", i->b);
+            break;
+    }
+    putchar('\n');
+}
+
+void ir_print(struct ir_program *prog) {
+    for (size_t f = 0; f < prog->funcs->length; f++) {
+        struct ir_func *fn = prog->funcs->data[f];
+        printf("func %s (frame %d, %d vregs)\n", fn->name, fn->frame_size, fn->num_vregs);
+        for (size_t b = 0; b < fn->blocks->length; b++) {
+            struct ir_block *bl = fn->blocks->data[b];
+            printf("b%d:\n", bl->id);
+            for (size_t i = 0; i < bl->length; i++) {
+                print_insn(fn, &bl->insns[i]);
+            }
+        }
+    }
+}
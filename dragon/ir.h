@@ -0,0 +1,114 @@
+#ifndef _IR_H
+#define _IR_H
+
+#include <stdio.h>
+
+#include "analysis.h"
+#include "ast.h"
+#include "symbol.h"
+#include "util.h"
+
+/* A linear three-address IR, between analysis and codegen. Each subprogram
+ * becomes an ir_func: a list of basic blocks of instructions over as many
+ * virtual registers as it likes, each with a type. Memory is only touched by
+ * explicit loads and stores, and every address is a register, plus another
+ * scaled by 1, 2, 4 or 8 if need be, plus a constant offset: what x86 can
+ * address in one go. Scalar locals nothing else can reach live in registers of their
+ * own. ir_build makes it from the analysed AST, -i prints it, and codegen
+ * lowers it to NASM. */
+
+#define IR_NONE (-1)
+
+// what a virtual register holds. i8 values are kept zero-extended.
+enum ir_type {
+    IR_VOID,
+    IR_I8,  // boolean, char
+    IR_I64, // integer
+    IR_PTR, // an address
+};
+
+enum ir_op {
+    IR_CONST,   // dst = imm
+    IR_MOV,     // dst = a
+    IR_ADD,     // dst = a op b
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_AND,
+    IR_OR,
+    IR_NEG,     // dst = op a
+    IR_NOT,
+    IR_EQ,      // dst = a rel b, as a boolean
+    IR_NE,
+    IR_LT,
+    IR_GT,
+    IR_LE,
+    IR_GE,
+    IR_FRAME,   // dst = the address imm bytes from the frame pointer
+    IR_DISPLAY, // dst = display slot imm
+    IR_SETDISP, // display slot imm = a
+    IR_LOAD,    // dst = [a + index*scale + imm], of type ty
+    IR_STORE,   // [a + index*scale + imm] = b, of type ty
+    IR_CALL,    // dst = sym(args...), or no dst
+    IR_JMP,     // goto target
+    IR_BR,      // goto a != 0 ? target : target2
+    IR_RET,     // return a, or nothing
+    NUM_IR_OPS,
+};
+
+struct ir_insn {
+    enum ir_op op;
+    enum ir_type ty; // of dst, or of what's loaded or stored
+    int dst, a, b;   // virtual registers, or IR_NONE
+    long imm;
+    // IR_LOAD and IR_STORE: a virtual register, or IR_NONE
+    int index, scale;
+    // IR_CALL
+    const char *sym;
+    int *args, nargs;
+    // IR_JMP and IR_BR: block ids
+    int target, target2;
+};
+
+struct ir_block {
+    int id; // its label
+    struct ir_insn *insns;
+    size_t length, capacity;
+};
+
+struct ir_func {
+    const char *name; // the symbol
+    bool main;
+    struct ptrvec *blocks; // in layout order; the first is the entry
+    int num_blocks;
+    enum ir_type *vregs; // the type of each
+    int num_vregs, vregs_capacity;
+    // the first num_locals are the variables kept in registers, which are
+    // assigned as often as the program says. every other one is assigned
+    // exactly once, before its uses in layout order.
+    int num_locals;
+    int frame_size; // bytes below the frame pointer the locals take
+};
+
+struct ir_program {
+    struct ptrvec *funcs;
+    int display_slots;
+    // the runtime routines called, each once, to declare extern.
+    struct ptrvec *externs;
+};
+
+struct ir_program *ir_build(struct ast_program *, struct acx *);
+void ir_print(struct ir_program *);
+
+// whether v is one of fn's variables rather than a temporary.
+static inline bool ir_is_local(struct ir_func *fn, int v) {
+    return v != IR_NONE && v < fn->num_locals;
+}
+
+// true for the ops that end a block.
+static inline bool ir_is_terminator(enum ir_op op) {
+    return op == IR_JMP || op == IR_BR || op == IR_RET;
+}
+
+#endif
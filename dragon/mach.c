@@ -0,0 +1,204 @@
+#include <string.h>
+
+#include "mach.h"
+#include "util.h"
+
+static const char *MOP_NAMES[NUM_MOPS] = {
+    [MOP_MOV] = "mov", [MOP_MOVZX] = "movzx", [MOP_LEA] = "lea",
+    [MOP_ADD] = "add", [MOP_SUB] = "sub", [MOP_IMUL] = "imul",
+    [MOP_AND] = "and", [MOP_OR] = "or", [MOP_XOR] = "xor", [MOP_NEG] = "neg",
+    [MOP_SHL] = "shl", [MOP_SAR] = "sar", [MOP_SHR] = "shr",
+    [MOP_CMP] = "cmp", [MOP_TEST] = "test", [MOP_SETCC] = "set",
+    [MOP_CQO] = "cqo", [MOP_IDIV] = "idiv", [MOP_PUSH] = "push",
+    [MOP_POP] = "pop", [MOP_CALL] = "call", [MOP_JMP] = "jmp", [MOP_JCC] = "j",
+    [MOP_RET] = "ret",
+};
+
+static const char *CC_NAMES[] = {
+    [CC_E] = "e", [CC_NE] = "ne", [CC_L] = "l", [CC_GE] = "ge", [CC_LE] = "le", [CC_G] = "g",
+};
+
+static const char *DWORD_NAMES[NUM_REGS] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+};
+
+struct minsn *mach_add(struct mvec *v, enum mop op) {
+    if (v->length == v->capacity) {
+        size_t cap = v->capacity ? v->capacity * 2 : 64;
+        v->data = xrealloc(v->data, v->capacity * sizeof(*v->data), cap * sizeof(*v->data));
+        v->capacity = cap;
+    }
+    struct minsn *i = &v->data[v->length++];
+    memset(i, 0, sizeof(*i));
+    i->op = op;
+    return i;
+}
+
+static void print_opnd(struct emitter *e, struct opnd *o) {
+    bool any = false;
+    switch (o->kind) {
+        case OPND_REG:
+            emit_str(e, o->size == 1 ? REG_BYTE_NAMES[o->reg]
+                    : o->size == 4 ? DWORD_NAMES[o->reg] : REG_NAMES[o->reg]);
+            break;
+        case OPND_IMM:
+            emit_int(e, o->imm);
+            break;
+        case OPND_MEM:
+            if (o->size == 1) emit_lit(e, "byte ");
+            else if (o->size == 8) emit_lit(e, "qword ");
+            emit_lit(e, "[");
+            if (o->sym) {
+                emit_str(e, o->sym);
+                any = true;
+            }
+            if (o->base != NO_REG) {
+                if (any) emit_lit(e, "+");
+                emit_str(e, REG_NAMES[o->base]);
+                any = true;
+            }
+            if (o->index != NO_REG) {
+                if (any) emit_lit(e, "+");
+                emit_str(e, REG_NAMES[o->index]);
+                if (o->scale != 1) {
+                    emit_lit(e, "*");
+                    emit_int(e, o->scale);
+                }
+                any = true;
+            }
+            if (o->disp != 0 || !any) {
+                if (any && o->disp > 0) emit_lit(e, "+");
+                emit_int(e, o->disp);
+            }
+            emit_lit(e, "]");
+            break;
+        default:
+            abort();
+    }
+}
+
+void mach_print(struct emitter *e, struct minsn *i) {
+    switch (i->op) {
+        case MOP_NONE:
+            return;
+        case MOP_LABEL:
+            emit_label_def(e, i->label);
+            return;
+        case MOP_JMP:
+        case MOP_JCC:
+            emit_str(e, MOP_NAMES[i->op]);
+            if (i->op == MOP_JCC) emit_str(e, CC_NAMES[i->cc]);
+            emit_lit(e, " ");
+            emit_label(e, i->label);
+            emit_lit(e, "\n");
+            return;
+        case MOP_CALL:
+            emit_insn1(e, "call", i->sym);
+            return;
+        default:
+            break;
+    }
+
+    emit_str(e, MOP_NAMES[i->op]);
+    if (i->op == MOP_SETCC) emit_str(e, CC_NAMES[i->cc]);
+    for (int k = 0; k < 3 && i->o[k].kind != OPND_NONE; k++) {
+        emit_str(e, k ? ", " : " ");
+        print_opnd(e, &i->o[k]);
+    }
+    emit_lit(e, "\n");
+}
+
+static unsigned addr_regs(struct opnd *o) {
+    unsigned m = 0;
+    if (o->kind != OPND_MEM) return 0;
+    if (o->base != NO_REG) m |= 1u << o->base;
+    if (o->index != NO_REG) m |= 1u << o->index;
+    return m;
+}
+
+static unsigned reg_of(struct opnd *o) {
+    return o->kind == OPND_REG ? 1u << o->reg : 0;
+}
+
+void mach_effects(struct minsn *i, unsigned *reads, unsigned *writes) {
+    unsigned r = addr_regs(&i->o[0]) | addr_regs(&i->o[1]) | addr_regs(&i->o[2]);
+    unsigned w = 0;
+    unsigned d = reg_of(&i->o[0]), s = reg_of(&i->o[1]);
+    // the frame and stack pointers are always live.
+    const unsigned frame = (1u << RSP) | (1u << RBP);
+
+    switch (i->op) {
+        case MOP_MOV:
+        case MOP_MOVZX:
+            r |= s;
+            w |= d;
+            break;
+        case MOP_LEA:
+            w |= d;
+            break;
+        case MOP_ADD:
+        case MOP_SUB:
+        case MOP_AND:
+        case MOP_OR:
+        case MOP_XOR:
+        case MOP_SHL:
+        case MOP_SAR:
+        case MOP_SHR:
+            r |= d | s;
+            w |= d | MACH_FLAGS;
+            break;
+        case MOP_IMUL:
+            if (i->o[1].kind == OPND_NONE) {
+                r |= d | (1u << RAX);
+                w |= (1u << RAX) | (1u << RDX) | MACH_FLAGS;
+            } else {
+                r |= s | (i->o[2].kind == OPND_NONE ? d : 0);
+                w |= d | MACH_FLAGS;
+            }
+            break;
+        case MOP_NEG:
+            r |= d;
+            w |= d | MACH_FLAGS;
+            break;
+        case MOP_CMP:
+        case MOP_TEST:
+            r |= d | s;
+            w |= MACH_FLAGS;
+            break;
+        case MOP_SETCC:
+            // only the low byte is written, but codegen always zero-extends
+            // it straight after, so the rest is never read.
+            r |= MACH_FLAGS;
+            w |= d;
+            break;
+        case MOP_CQO:
+            r |= 1u << RAX;
+            w |= 1u << RDX;
+            break;
+        case MOP_IDIV:
+            r |= d | (1u << RAX) | (1u << RDX);
+            w |= (1u << RAX) | (1u << RDX) | MACH_FLAGS;
+            break;
+        case MOP_PUSH:
+            r |= d | frame;
+            break;
+        case MOP_POP:
+            w |= d;
+            break;
+        case MOP_CALL:
+            r |= frame;
+            w |= call_clobbers(i->sym) | MACH_FLAGS;
+            break;
+        case MOP_JCC:
+            r |= MACH_FLAGS;
+            break;
+        case MOP_RET:
+            r |= (1u << RAX) | CALLEE_SAVED | frame;
+            break;
+        default:
+            break;
+    }
+    *reads = r;
+    *writes = w;
+}
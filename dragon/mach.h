@@ -0,0 +1,81 @@
+#ifndef _MACH_H
+#define _MACH_H
+
+#include "emit.h"
+#include "regalloc.h"
+
+/* x86-64 instructions as codegen makes them, before they're printed: what
+ * the peephole pass (peep.c) rewrites. Only what codegen uses is here. */
+
+enum mop {
+    MOP_NONE, // deleted
+    MOP_LABEL,
+    MOP_MOV,
+    MOP_MOVZX,
+    MOP_LEA,
+    MOP_ADD,
+    MOP_SUB,
+    MOP_IMUL, // rdx:rax = rax * one operand, or two, or three with an immediate
+    MOP_AND,
+    MOP_OR,
+    MOP_XOR,
+    MOP_NEG,
+    MOP_SHL, // by an immediate
+    MOP_SAR,
+    MOP_SHR,
+    MOP_CMP,
+    MOP_TEST,
+    MOP_SETCC,
+    MOP_CQO,
+    MOP_IDIV,
+    MOP_PUSH,
+    MOP_POP,
+    MOP_CALL,
+    MOP_JMP,
+    MOP_JCC,
+    MOP_RET,
+    NUM_MOPS,
+};
+
+// condition codes, in pairs: cc ^ 1 is the opposite of cc.
+enum cc { CC_E, CC_NE, CC_L, CC_GE, CC_LE, CC_G };
+
+enum opnd_kind { OPND_NONE, OPND_REG, OPND_IMM, OPND_MEM };
+
+#define NO_REG (-1)
+
+struct opnd {
+    enum opnd_kind kind;
+    int size; // bytes: 1, 4 or 8. lea's memory operand has none.
+    int reg;
+    long imm;
+    // [sym + base + index*scale + disp], any part of which may be missing
+    const char *sym;
+    int base, index, scale;
+    long disp;
+};
+
+struct minsn {
+    enum mop op;
+    enum cc cc;      // of setcc and jcc
+    struct opnd o[3]; // the destination first, as NASM has it
+    const char *sym; // what's called
+    int label;       // what's defined or jumped to
+};
+
+struct mvec {
+    struct minsn *data;
+    size_t length, capacity;
+};
+
+// a new, empty instruction at the end.
+struct minsn *mach_add(struct mvec *, enum mop);
+void mach_print(struct emitter *, struct minsn *);
+
+// the flags, as one more register in masks of them.
+#define MACH_FLAGS (1u << NUM_REGS)
+
+// the registers (and flags) an instruction reads, and those it writes.
+void mach_effects(struct minsn *, unsigned *reads, unsigned *writes);
+
+#endif
@@ -1,31 +1,40 @@
 #include <stdio.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "driver.h"
+#include "peep.h"
+#include "util.h"
 
-extern int yydebug;
-
-static char *USAGE = "usage: comp [-lpinNCd] <filename>";
+static char *USAGE = "usage: comp [-lpinNCdtT] [-j jobs] [-P rule,...|all] <filename>...";
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "error: unrecognized number of arguments: %d\n", argc);
-        fprintf(stderr, "%s\n", USAGE);
-        return 1;
-    }
-    int fd = open(argv[argc-1], O_RDONLY);
-    if (fd == -1) return 1;
-    ssize_t len = lseek(fd, 0, SEEK_END);
-    if (len == -1) return 1;
-    char *data = mmap(0, (size_t)len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED) return 1;
-
-    int options = 0;
-    if (argc == 3) {
-        for (char *c = argv[1] + 1; *c; c++) {
+    int options = 0, jobs = 0;
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if (++i == argc || (jobs = atoi(argv[i])) < 1) {
+                fprintf(stderr, "error: -j needs a positive number of jobs\n");
+                return 1;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "-P") == 0) {
+            if (++i == argc) {
+                fprintf(stderr, "error: -P needs peephole rules to turn off\n");
+                return 1;
+            }
+            for (char *name = strtok(argv[i], ","); name; name = strtok(NULL, ",")) {
+                int r = strcmp(name, "all") == 0 ? NUM_PEEP_RULES : peep_find(name);
+                if (r < 0) {
+                    fprintf(stderr, "error: unknown peephole rule: %s\n", name);
+                    return 1;
+                }
+                options |= (r == NUM_PEEP_RULES ? (1 << NUM_PEEP_RULES) - 1 : 1 << r) << PEEP_OFF_SHIFT;
+            }
+            continue;
+        }
+        for (char *c = argv[i] + 1; *c; c++) {
             switch (*c) {
                 case 'l':
                     options |= DUMP_TOKENS;
@@ -46,7 +55,13 @@ int main(int argc, char **argv) {
                     options |= NO_CODEGEN;
                     break;
                 case 'd':
-                    yydebug = 1;
+                    options |= TRACE_PARSE;
+                    break;
+                case 't':
+                    options |= TIME_REPORT;
+                    break;
+                case 'T':
+                    options |= TIME_REPORT_JSON;
                     break;
                 default:
                     fprintf(stderr, "unknown flag: %c\n", *c);
@@ -56,7 +71,22 @@ int main(int argc, char **argv) {
         }
     }
 
-    compile_input(data, (size_t)len, options);
+    int count = argc - i;
+    if (count < 1) {
+        fprintf(stderr, "error: no input files\n");
+        fprintf(stderr, "%s\n", USAGE);
+        return 1;
+    }
 
-    return 0;
+    // a single input without -j compiles to stdout, as it always has.
+    if (count == 1 && jobs == 0) {
+        return compile_file(argv[i], options, stdout, NULL);
+    }
+
+    // the dumps all go to stdout, and would interleave.
+    if (options & (DUMP_TOKENS | DUMP_AST | DUMP_IR | TRACE_PARSE)) {
+        fprintf(stderr, "error: -l, -p, -i and -d need a single input\n");
+        return 1;
+    }
+    return compile_files(argv + i, count, jobs ? jobs : 1, options);
 }
@@ -0,0 +1,307 @@
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ir.h"
+#include "opt.h"
+#include "util.h"
+
+/* Each virtual register but the locals is assigned exactly once, by an
+ * instruction laid out before any of its uses, so a single pass in layout
+ * order sees every value's definition before it's needed. The locals can be
+ * assigned anywhere, so nothing is known of them, and nothing is made a copy
+ * of one: it might have changed by the time the copy's used. */
+
+struct fold {
+    struct ir_func *fn;
+    int *alias;  // what each register is a copy of, or itself
+    bool *known; // whether it holds a constant,
+    long *value; // and which
+};
+
+static int resolve(struct fold *f, int v) {
+    return v == IR_NONE ? v : f->alias[v];
+}
+
+static void make_const(struct fold *f, struct ir_insn *i, long value) {
+    i->op = IR_CONST;
+    i->a = i->b = IR_NONE;
+    i->imm = value;
+    if (ir_is_local(f->fn, i->dst)) return;
+    f->known[i->dst] = true;
+    f->value[i->dst] = value;
+}
+
+// uses of dst become uses of v.
+static void make_copy(struct fold *f, struct ir_insn *i, int v) {
+    i->op = IR_MOV;
+    i->a = v;
+    i->b = IR_NONE;
+    if (f->known[v]) {
+        make_const(f, i, f->value[v]);
+    } else if (!ir_is_local(f->fn, i->dst) && !ir_is_local(f->fn, v)) {
+        f->alias[i->dst] = v;
+    }
+}
+
+// a op b, if it can be worked out here. arithmetic wraps, like the machine's.
+static bool eval(enum ir_op op, long a, long b, long *r) {
+    switch (op) {
+        case IR_ADD: *r = (long) ((unsigned long) a + (unsigned long) b); return true;
+        case IR_SUB: *r = (long) ((unsigned long) a - (unsigned long) b); return true;
+        case IR_MUL: *r = (long) ((unsigned long) a * (unsigned long) b); return true;
+        case IR_DIV:
+        case IR_MOD:
+            // these trap at run time; leave them to.
+            if (b == 0 || (a == LONG_MIN && b == -1)) return false;
+            *r = op == IR_DIV ? a / b : a % b;
+            return true;
+        case IR_AND: *r = a & b; return true;
+        case IR_OR: *r = a | b; return true;
+        case IR_EQ: *r = a == b; return true;
+        case IR_NE: *r = a != b; return true;
+        case IR_LT: *r = a < b; return true;
+        case IR_GT: *r = a > b; return true;
+        case IR_LE: *r = a <= b; return true;
+        case IR_GE: *r = a >= b; return true;
+        default: return false;
+    }
+}
+
+static bool is_ir_relop(enum ir_op op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+// the identities, for a binary operation with at most one constant operand.
+static void simplify(struct fold *f, struct ir_insn *i) {
+    int a = i->a, b = i->b;
+    bool ka = f->known[a], kb = f->known[b];
+    long va = f->value[a], vb = f->value[b];
+    // booleans are 0 or 1, so 1 is all their bits.
+    long ones = i->ty == IR_I8 ? 1 : -1;
+
+    if (a == b) {
+        switch (i->op) {
+            case IR_SUB: make_const(f, i, 0); return;
+            case IR_AND: case IR_OR: make_copy(f, i, a); return;
+            case IR_EQ: case IR_LE: case IR_GE: make_const(f, i, 1); return;
+            case IR_NE: case IR_LT: case IR_GT: make_const(f, i, 0); return;
+            default: break;
+        }
+    }
+
+    switch (i->op) {
+        case IR_ADD:
+            if (kb && vb == 0) make_copy(f, i, a);
+            else if (ka && va == 0) make_copy(f, i, b);
+            break;
+        case IR_SUB:
+            if (kb && vb == 0) make_copy(f, i, a);
+            break;
+        case IR_MUL:
+            if ((kb && vb == 0) || (ka && va == 0)) make_const(f, i, 0);
+            else if (kb && vb == 1) make_copy(f, i, a);
+            else if (ka && va == 1) make_copy(f, i, b);
+            break;
+        case IR_DIV:
+            if (kb && vb == 1) make_copy(f, i, a);
+            break;
+        case IR_MOD:
+            if (kb && (vb == 1 || vb == -1)) make_const(f, i, 0);
+            break;
+        case IR_AND:
+            if ((kb && vb == 0) || (ka && va == 0)) make_const(f, i, 0);
+            else if (kb && vb == ones) make_copy(f, i, a);
+            else if (ka && va == ones) make_copy(f, i, b);
+            break;
+        case IR_OR:
+            if ((kb && vb == ones) || (ka && va == ones)) make_const(f, i, ones);
+            else if (kb && vb == 0) make_copy(f, i, a);
+            else if (ka && va == 0) make_copy(f, i, b);
+            break;
+        default:
+            break;
+    }
+}
+
+static void fold_insn(struct fold *f, struct ir_insn *i) {
+    i->a = resolve(f, i->a);
+    i->b = resolve(f, i->b);
+    i->index = resolve(f, i->index);
+    for (int j = 0; j < i->nargs; j++) {
+        i->args[j] = resolve(f, i->args[j]);
+    }
+
+    long r;
+    switch (i->op) {
+        case IR_CONST:
+            make_const(f, i, i->imm);
+            break;
+        case IR_MOV:
+            make_copy(f, i, i->a);
+            break;
+        case IR_NEG:
+            if (f->known[i->a]) make_const(f, i, (long) -(unsigned long) f->value[i->a]);
+            break;
+        case IR_NOT:
+            if (f->known[i->a]) make_const(f, i, f->value[i->a] ^ 1);
+            break;
+        case IR_LOAD:
+        case IR_STORE:
+            // a known index is part of the offset, as long as that still fits.
+            if (i->index != IR_NONE && f->known[i->index]) {
+                r = (long) ((unsigned long) i->imm + (unsigned long) f->value[i->index] * i->scale);
+                if (r >= INT32_MIN && r <= INT32_MAX) {
+                    i->imm = r;
+                    i->index = IR_NONE;
+                    i->scale = 1;
+                }
+            }
+            break;
+        case IR_BR:
+            // the branch not taken, and what only it reached, goes.
+            if (f->known[i->a]) {
+                i->op = IR_JMP;
+                if (f->value[i->a] == 0) i->target = i->target2;
+                i->target2 = IR_NONE;
+                i->a = IR_NONE;
+            }
+            break;
+        default:
+            if ((i->op >= IR_ADD && i->op <= IR_OR) || is_ir_relop(i->op)) {
+                if (f->known[i->a] && f->known[i->b] && eval(i->op, f->value[i->a], f->value[i->b], &r)) {
+                    make_const(f, i, r);
+                } else {
+                    simplify(f, i);
+                }
+            }
+            break;
+    }
+}
+
+// drop the blocks nothing jumps to any more.
+static void prune_blocks(struct ir_func *fn) {
+    struct ir_block **by_id = xcalloc(fn->num_blocks * sizeof(*by_id));
+    bool *reached = xcalloc(fn->num_blocks * sizeof(*reached));
+    int *work = xcalloc(fn->num_blocks * sizeof(*work));
+    int n = 0;
+
+    for (size_t b = 0; b < fn->blocks->length; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        by_id[bl->id] = bl;
+    }
+
+    struct ir_block *entry = fn->blocks->data[0];
+    reached[entry->id] = true;
+    work[n++] = entry->id;
+    while (n > 0) {
+        struct ir_block *bl = by_id[work[--n]];
+        if (bl->length == 0) continue;
+        struct ir_insn *last = &bl->insns[bl->length - 1];
+        int targets[2] = { last->target, last->target2 };
+        for (int t = 0; t < 2; t++) {
+            if (targets[t] != IR_NONE && !reached[targets[t]]) {
+                reached[targets[t]] = true;
+                work[n++] = targets[t];
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t b = 0; b < fn->blocks->length; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        if (reached[bl->id]) fn->blocks->data[kept++] = bl;
+    }
+    fn->blocks->length = kept;
+
+    D(work);
+    D(reached);
+    D(by_id);
+}
+
+static bool is_pure(enum ir_op op) {
+    switch (op) {
+        case IR_CONST: case IR_MOV:
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_AND: case IR_OR:
+        case IR_NEG: case IR_NOT:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_FRAME: case IR_DISPLAY: case IR_LOAD:
+            return true;
+        default:
+            // division can trap, and the rest do something.
+            return false;
+    }
+}
+
+static void use(int *uses, struct ir_insn *i, int delta) {
+    if (i->a != IR_NONE) uses[i->a] += delta;
+    if (i->b != IR_NONE) uses[i->b] += delta;
+    if (i->index != IR_NONE) uses[i->index] += delta;
+    for (int j = 0; j < i->nargs; j++) {
+        uses[i->args[j]] += delta;
+    }
+}
+
+// remove what computes values nothing uses. uses come after definitions, so
+// going backwards frees a whole chain at once.
+static void remove_dead(struct ir_func *fn) {
+    int *uses = xcalloc(fn->num_vregs * sizeof(*uses));
+    for (size_t b = 0; b < fn->blocks->length; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        for (size_t i = 0; i < bl->length; i++) {
+            use(uses, &bl->insns[i], 1);
+        }
+    }
+
+    for (size_t b = fn->blocks->length; b-- > 0;) {
+        struct ir_block *bl = fn->blocks->data[b];
+        size_t kept = bl->length;
+        for (size_t i = bl->length; i-- > 0;) {
+            struct ir_insn *in = &bl->insns[i];
+            if (is_pure(in->op) && in->dst != IR_NONE && uses[in->dst] == 0) {
+                use(uses, in, -1);
+                in->op = NUM_IR_OPS; // gone
+                kept--;
+            }
+        }
+        if (kept == bl->length) continue;
+        size_t k = 0;
+        for (size_t i = 0; i < bl->length; i++) {
+            if (bl->insns[i].op != NUM_IR_OPS) bl->insns[k++] = bl->insns[i];
+        }
+        bl->length = k;
+    }
+
+    D(uses);
+}
+
+static void fold_func(struct ir_func *fn) {
+    struct fold f;
+    f.fn = fn;
+    f.alias = xcalloc(fn->num_vregs * sizeof(*f.alias));
+    f.known = xcalloc(fn->num_vregs * sizeof(*f.known));
+    f.value = xcalloc(fn->num_vregs * sizeof(*f.value));
+    for (int v = 0; v < fn->num_vregs; v++) {
+        f.alias[v] = v;
+    }
+
+    for (size_t b = 0; b < fn->blocks->length; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        for (size_t i = 0; i < bl->length; i++) {
+            fold_insn(&f, &bl->insns[i]);
+        }
+    }
+
+    prune_blocks(fn);
+    remove_dead(fn);
+
+    D(f.value);
+    D(f.known);
+    D(f.alias);
+}
+
+void opt_fold(struct ir_program *prog) {
+    for (size_t f = 0; f < prog->funcs->length; f++) {
+        fold_func(prog->funcs->data[f]);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef _OPT_H
+#define _OPT_H
+
+#include "ir.h"
+
+/* Optimisations over the IR, between ir_build and codegen. */
+
+// constant folding and algebraic simplification, then pruning what that
+// made dead: branches on constants and the blocks only they reached, and
+// instructions whose results nothing uses.
+void opt_fold(struct ir_program *);
+
+#endif
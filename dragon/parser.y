@@ -2,13 +2,27 @@
 #define YYERROR_VERBOSE
 #include "ast.h"
 #include "util.h"
-#include "lexer.h"
+#include "scanner.h"
 
 extern int yyerror(YYLTYPE *, struct ast_program **, int options, void *scanner, const char *s);
 %}
 
 %code requires {
+#include <stdint.h>
 struct ast_program;
+
+/* A location is just the byte offset of the start of the token. Lines and
+ * columns are only needed for diagnostics, so source_pos works them out when
+ * something is actually printed. */
+typedef struct YYLTYPE {
+    uint32_t offset;
+} YYLTYPE;
+#define YYLTYPE_IS_DECLARED 1
+
+// a rule starts where its first symbol does; an empty one where the previous
+// symbol did.
+#define YYLLOC_DEFAULT(Cur, Rhs, N) \
+    ((Cur).offset = YYRHSLOC(Rhs, (N) ? 1 : 0).offset)
 }
 
 %expect 0
@@ -57,11 +71,11 @@ struct ast_program;
     struct ast_expr *expr;
     struct ast_path *path;
     enum yytokentype tok;
-    char *name;
+    uint32_t name; // an ident
 }
 
 %destructor { free_expr($$); } <expr>
-%destructor { free($$); } <name>
+%destructor { } <name>
 %destructor { free_path($$); } <path>
 %destructor { free_stmt($$); } <stmt>
 %destructor { free_subprogram_decl($$); } <subdecl>
@@ -101,7 +115,7 @@ struct ast_program;
 %precedence THEN
 %precedence ELSE
 
-%pure-parser
+%define api.pure
 %lex-param {void * scanner}
 %parse-param {struct ast_program **res}
 %parse-param {int options}
@@ -126,11 +140,11 @@ type_declarations : type_declarations TYPE ID '=' type ';' { $$ = $1; list_add($
                   ;
 
 optional_identifier_list : identifier_list
-                         | %empty { $$ = list_empty(free); }
+                         | %empty { $$ = list_empty(dummy_free); }
                          ;
 
-identifier_list : ID                       { $$ = list_new($1, free); }
-                | identifier_list ',' ID { $$ = $1; list_add($$, $3); }
+identifier_list : ID                       { $$ = list_new(IDENT_P($1), dummy_free); }
+                | identifier_list ',' ID { $$ = $1; list_add($$, IDENT_P($3)); }
                 ;
 
 declarations : declarations VAR identifier_list ':' type ';' { $$ = $1; list_add($$, ast_decls($3, $5)); }
@@ -207,7 +221,7 @@ lvalue : path                    { $$ = ast_expr(EXPR_PATH,  $1    ); }
        | path '^'                { $$ = ast_expr(EXPR_DEREF, ast_expr(EXPR_PATH, $1)); }
        ;
 
-procedure_statement : path                         { $$ = ast_stmt(STMT_PROC, $1, list_empty(CB free)); }
+procedure_statement : path                         { $$ = ast_stmt(STMT_PROC, $1, list_empty(CB xfree)); }
                     | path '(' expression_list ')' { $$ = ast_stmt(STMT_PROC, $1, $3);   }
                     ;
 
@@ -260,3 +274,15 @@ mulop : '*' { $$ = '*'; }
       | MOD { $$ = MOD; }
       | AND { $$ = AND; }
       ;
+
+%%
+
+int yyerror(YYLTYPE *loc, struct ast_program **p, int options, void *scanner, const char *s) {
+    int line, col;
+    source_pos(current_source, loc->offset, &line, &col);
+    if (current_source && current_source->name) {
+        printf("%s: ", current_source->name);
+    }
+    printf("parse error at line %d: %s\n", line, s);
+    return 0;
+}
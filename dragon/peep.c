@@ -0,0 +1,317 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "peep.h"
+#include "util.h"
+
+const char *PEEP_NAMES[NUM_PEEP_RULES] = {
+    [PEEP_DEAD_MOV] = "dead-mov", [PEEP_SELF_MOV] = "self-mov",
+    [PEEP_MOV_BACK] = "mov-back", [PEEP_XOR_ZERO] = "xor-zero",
+    [PEEP_ADD_ZERO] = "add-zero", [PEEP_LEA_COPY] = "lea-copy",
+    [PEEP_LEA_ADD] = "lea-add", [PEEP_MOV_ADD] = "mov-add",
+    [PEEP_LEA_MEM] = "lea-mem", [PEEP_SETCC_JCC] = "setcc-jcc",
+    [PEEP_JMP_NEXT] = "jmp-next",
+};
+
+int peep_find(const char *name) {
+    for (int r = 0; r < NUM_PEEP_RULES; r++) {
+        if (strcmp(PEEP_NAMES[r], name) == 0) return r;
+    }
+    return -1;
+}
+
+struct peep {
+    struct mvec *code;
+    int *label_at;     // where each label is defined
+    unsigned *live_in; // registers (and flags) live before each instruction
+    unsigned *reads, *writes; // and what each reads and writes, for liveness
+};
+
+// what's live after instruction k, from what's live into its successors.
+static unsigned live_after(struct peep *p, size_t k) {
+    struct minsn *i = &p->code->data[k];
+    unsigned next = k + 1 < p->code->length ? p->live_in[k + 1] : 0;
+    switch (i->op) {
+        case MOP_JMP: return p->live_in[p->label_at[i->label]];
+        case MOP_JCC: return p->live_in[p->label_at[i->label]] | next;
+        case MOP_RET: return 0;
+        default: return next;
+    }
+}
+
+// to a fixed point, instruction by instruction: the code's small enough.
+static void liveness(struct peep *p) {
+    size_t n = p->code->length;
+    memset(p->live_in, 0, n * sizeof(*p->live_in));
+    for (size_t k = 0; k < n; k++) {
+        if (p->code->data[k].op == MOP_LABEL) p->label_at[p->code->data[k].label] = k;
+        mach_effects(&p->code->data[k], &p->reads[k], &p->writes[k]);
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t k = n; k-- > 0;) {
+            unsigned in = p->reads[k] | (live_after(p, k) & ~p->writes[k]);
+            if (in != p->live_in[k]) {
+                p->live_in[k] = in;
+                changed = true;
+            }
+        }
+    }
+}
+
+static bool dead_after(struct peep *p, size_t k, unsigned mask) {
+    return (live_after(p, k) & mask) == 0;
+}
+
+static bool is_reg(struct opnd *o, int size) {
+    return o->kind == OPND_REG && o->size == size;
+}
+
+static bool is_imm(struct opnd *o, long n) {
+    return o->kind == OPND_IMM && o->imm == n;
+}
+
+static bool same(struct opnd *a, struct opnd *b) {
+    if (a->kind != b->kind || a->size != b->size) return false;
+    switch (a->kind) {
+        case OPND_REG: return a->reg == b->reg;
+        case OPND_IMM: return a->imm == b->imm;
+        case OPND_MEM:
+            return a->sym == b->sym && a->base == b->base && a->index == b->index
+                && a->scale == b->scale && a->disp == b->disp;
+        default: return true;
+    }
+}
+
+static bool uses_reg(struct opnd *o, int reg) {
+    switch (o->kind) {
+        case OPND_REG: return o->reg == reg;
+        case OPND_MEM: return o->base == reg || o->index == reg;
+        default: return false;
+    }
+}
+
+static bool fits_disp(long n) {
+    return n >= INT32_MIN && n <= INT32_MAX;
+}
+
+static void drop(struct minsn *i) {
+    i->op = MOP_NONE;
+}
+
+/* The rules. Each gets the instructions from k on, as many as its window, and
+ * rewrites them if they match, returning whether they did. */
+
+static bool dead_mov(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_MOV && w[0].op != MOP_MOVZX && w[0].op != MOP_LEA) return false;
+    if (w[0].o[0].kind != OPND_REG || w[0].o[0].reg == RSP || w[0].o[0].reg == RBP) return false;
+    if (!dead_after(p, k, 1u << w[0].o[0].reg)) return false;
+    drop(&w[0]);
+    return true;
+}
+
+static bool self_mov(struct peep *p, struct minsn *w, size_t k) {
+    // mov r32, r32 clears the top half, so it's not one of these.
+    if (w[0].op != MOP_MOV || !is_reg(&w[0].o[0], 8) || !same(&w[0].o[0], &w[0].o[1])) return false;
+    drop(&w[0]);
+    return true;
+}
+
+static bool mov_back(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_MOV || w[1].op != MOP_MOV) return false;
+    if (!same(&w[0].o[0], &w[1].o[1]) || !same(&w[0].o[1], &w[1].o[0])) return false;
+    // the first mustn't have changed where the second reads from.
+    if (w[0].o[1].kind == OPND_MEM && uses_reg(&w[0].o[1], w[0].o[0].reg)) return false;
+    drop(&w[1]);
+    return true;
+}
+
+static bool xor_zero(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_MOV || !is_reg(&w[0].o[0], 8) || !is_imm(&w[0].o[1], 0)) return false;
+    // xor sets the flags; mov doesn't.
+    if (!dead_after(p, k, MACH_FLAGS)) return false;
+    w[0].op = MOP_XOR;
+    w[0].o[0].size = 4;
+    w[0].o[1] = w[0].o[0];
+    return true;
+}
+
+static bool add_zero(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_ADD && w[0].op != MOP_SUB) return false;
+    if (!is_imm(&w[0].o[1], 0) || !dead_after(p, k, MACH_FLAGS)) return false;
+    drop(&w[0]);
+    return true;
+}
+
+static bool lea_copy(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_LEA || w[1].op != MOP_MOV) return false;
+    if (!is_reg(&w[1].o[0], 8) || !same(&w[0].o[0], &w[1].o[1])) return false;
+    int t = w[0].o[0].reg;
+    if (w[1].o[0].reg != t && !dead_after(p, k + 1, 1u << t)) return false;
+    w[0].o[0] = w[1].o[0];
+    drop(&w[1]);
+    return true;
+}
+
+static bool lea_add(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_LEA || (w[1].op != MOP_ADD && w[1].op != MOP_SUB)) return false;
+    if (!same(&w[0].o[0], &w[1].o[0]) || w[1].o[1].kind != OPND_IMM) return false;
+    long disp = w[0].o[1].disp + (w[1].op == MOP_ADD ? w[1].o[1].imm : -w[1].o[1].imm);
+    if (!fits_disp(disp) || !dead_after(p, k + 1, MACH_FLAGS)) return false;
+    w[0].o[1].disp = disp;
+    drop(&w[1]);
+    return true;
+}
+
+static bool mov_add(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_MOV || !is_reg(&w[0].o[0], 8) || !is_reg(&w[0].o[1], 8)) return false;
+    if ((w[1].op != MOP_ADD && w[1].op != MOP_SUB) || !same(&w[0].o[0], &w[1].o[0])) return false;
+    if (w[1].o[1].kind != OPND_IMM) return false;
+    long disp = w[1].op == MOP_ADD ? w[1].o[1].imm : -w[1].o[1].imm;
+    if (!fits_disp(disp) || !dead_after(p, k + 1, MACH_FLAGS)) return false;
+    struct opnd m;
+    memset(&m, 0, sizeof(m));
+    m.kind = OPND_MEM;
+    m.base = w[0].o[1].reg;
+    m.index = NO_REG;
+    m.scale = 1;
+    m.disp = disp;
+    w[0].op = MOP_LEA;
+    w[0].o[1] = m;
+    drop(&w[1]);
+    return true;
+}
+
+static bool lea_mem(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_LEA || w[1].op == MOP_LEA || w[1].op == MOP_LABEL) return false;
+    int t = w[0].o[0].reg, m = -1;
+    // t's dead afterwards, or the instruction only overwrites it.
+    bool overwrites = (w[1].op == MOP_MOV || w[1].op == MOP_MOVZX) && is_reg(&w[1].o[0], 8)
+        && w[1].o[0].reg == t;
+    for (int j = 0; j < 3; j++) {
+        struct opnd *o = &w[1].o[j];
+        if (o->kind == OPND_MEM && o->base == t && o->index != t) {
+            m = j;
+        } else if (uses_reg(o, t) && !(j == 0 && overwrites)) {
+            return false;
+        }
+    }
+    if (m < 0) return false;
+    if (!overwrites && !dead_after(p, k + 1, 1u << t)) return false;
+
+    struct opnd *a = &w[0].o[1], *o = &w[1].o[m];
+    if (o->index != NO_REG && a->index != NO_REG) return false;
+    long disp = a->disp + o->disp;
+    if (!fits_disp(disp)) return false;
+    struct opnd merged = *a;
+    merged.size = o->size;
+    merged.disp = disp;
+    if (o->index != NO_REG) {
+        merged.index = o->index;
+        merged.scale = o->scale;
+    }
+    *o = merged;
+    drop(&w[0]);
+    return true;
+}
+
+static bool setcc_jcc(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_SETCC || w[1].op != MOP_MOVZX || w[2].op != MOP_TEST || w[3].op != MOP_JCC) return false;
+    int r = w[0].o[0].reg;
+    if (!is_reg(&w[1].o[0], 8) || w[1].o[0].reg != r || !is_reg(&w[1].o[1], 1) || w[1].o[1].reg != r) return false;
+    if (!is_reg(&w[2].o[0], 8) || w[2].o[0].reg != r || !same(&w[2].o[0], &w[2].o[1])) return false;
+    if (w[3].cc != CC_E && w[3].cc != CC_NE) return false;
+    if (!dead_after(p, k + 3, 1u << r)) return false;
+    // jne goes where the condition held, je where it didn't.
+    w[3].cc = w[3].cc == CC_NE ? w[0].cc : w[0].cc ^ 1;
+    drop(&w[0]);
+    drop(&w[1]);
+    drop(&w[2]);
+    return true;
+}
+
+static bool jmp_next(struct peep *p, struct minsn *w, size_t k) {
+    if (w[0].op != MOP_JMP) return false;
+    for (size_t j = k + 1; j < p->code->length; j++) {
+        struct minsn *i = &p->code->data[j];
+        if (i->op == MOP_NONE) continue;
+        if (i->op != MOP_LABEL) return false;
+        if (i->label == w[0].label) {
+            drop(&w[0]);
+            return true;
+        }
+    }
+    return false;
+}
+
+#define OP(op) (1u << MOP_##op)
+
+// ops is what the window's first instruction can be, so the rest are passed
+// over without a call.
+static const struct {
+    int window;
+    unsigned ops;
+    bool (*apply)(struct peep *, struct minsn *, size_t);
+} RULES[NUM_PEEP_RULES] = {
+    [PEEP_DEAD_MOV] = { 1, OP(MOV) | OP(MOVZX) | OP(LEA), dead_mov },
+    [PEEP_SELF_MOV] = { 1, OP(MOV), self_mov },
+    [PEEP_MOV_BACK] = { 2, OP(MOV), mov_back },
+    [PEEP_XOR_ZERO] = { 1, OP(MOV), xor_zero },
+    [PEEP_ADD_ZERO] = { 1, OP(ADD) | OP(SUB), add_zero },
+    [PEEP_LEA_COPY] = { 2, OP(LEA), lea_copy },
+    [PEEP_LEA_ADD] = { 2, OP(LEA), lea_add },
+    [PEEP_MOV_ADD] = { 2, OP(MOV), mov_add },
+    [PEEP_LEA_MEM] = { 2, OP(LEA), lea_mem },
+    [PEEP_SETCC_JCC] = { 4, OP(SETCC), setcc_jcc },
+    [PEEP_JMP_NEXT] = { 1, OP(JMP), jmp_next },
+};
+
+// one rewrite can make way for another, but not forever.
+#define MAX_SWEEPS 8
+
+void peephole(struct mvec *code, int num_labels, unsigned off, long *counts) {
+    struct peep p;
+    p.code = code;
+    p.label_at = xcalloc((num_labels + 1) * sizeof(*p.label_at));
+    p.live_in = xcalloc((code->length + 1) * sizeof(*p.live_in));
+    p.reads = xcalloc((code->length + 1) * sizeof(*p.reads));
+    p.writes = xcalloc((code->length + 1) * sizeof(*p.writes));
+
+    for (int sweep = 0; sweep < MAX_SWEEPS; sweep++) {
+        liveness(&p);
+
+        // a rewritten window is stepped over: liveness is only sure to hold
+        // for what's not been touched since it was worked out.
+        bool changed = false;
+        size_t n = code->length;
+        for (size_t k = 0; k < n;) {
+            size_t step = 1;
+            for (int r = 0; r < NUM_PEEP_RULES; r++) {
+                if ((off & (1u << r)) || !(RULES[r].ops & (1u << code->data[k].op))
+                    || k + RULES[r].window > n) {
+                    continue;
+                }
+                if (RULES[r].apply(&p, &code->data[k], k)) {
+                    counts[r]++;
+                    changed = true;
+                    step = RULES[r].window;
+                    break;
+                }
+            }
+            k += step;
+        }
+        if (!changed) break;
+
+        size_t kept = 0;
+        for (size_t k = 0; k < n; k++) {
+            if (code->data[k].op != MOP_NONE) code->data[kept++] = code->data[k];
+        }
+        code->length = kept;
+    }
+
+    D(p.writes);
+    D(p.reads);
+    D(p.live_in);
+    D(p.label_at);
+}
@@ -0,0 +1,36 @@
+#ifndef _PEEP_H
+#define _PEEP_H
+
+#include "mach.h"
+
+/* The peephole pass: a table of rewrites over a few instructions at a time,
+ * slid over a function's machine code (see mach.h) until none applies. Rules
+ * that need a register or the flags to be dead afterwards ask a liveness
+ * analysis of the code, redone before each sweep. Each rule can be turned off
+ * on its own (-P), and counts how often it applied (-t). */
+
+enum peep_rule {
+    PEEP_DEAD_MOV,  // mov r, x; r is never read
+    PEEP_SELF_MOV,  // mov r, r
+    PEEP_MOV_BACK,  // mov a, b; mov b, a: the second's a no-op
+    PEEP_XOR_ZERO,  // mov r, 0 -> xor r32, r32
+    PEEP_ADD_ZERO,  // add/sub x, 0
+    PEEP_LEA_COPY,  // lea t, [m]; mov r, t -> lea r, [m]
+    PEEP_LEA_ADD,   // lea r, [m]; add r, n -> lea r, [m+n]
+    PEEP_MOV_ADD,   // mov r, s; add r, n -> lea r, [s+n]
+    PEEP_LEA_MEM,   // lea t, [m]; op .., [t+n] -> op .., [m+n]
+    PEEP_SETCC_JCC, // setcc b; movzx r, b; test r, r; je/jne -> jcc
+    PEEP_JMP_NEXT,  // jmp to a label right after
+    NUM_PEEP_RULES,
+};
+
+extern const char *PEEP_NAMES[NUM_PEEP_RULES];
+
+// the rule called name, or -1.
+int peep_find(const char *name);
+
+// rewrite code, whose labels are below num_labels, with the rules not in
+// off (1 << rule each), adding how often each applied to counts.
+void peephole(struct mvec *code, int num_labels, unsigned off, long *counts);
+
+#endif
@@ -0,0 +1,319 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "regalloc.h"
+#include "util.h"
+
+const char *REG_NAMES[NUM_REGS] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+const char *REG_BYTE_NAMES[NUM_REGS] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+};
+
+// the order registers are handed out in.
+static const enum reg CALLER_ORDER[] = { RSI, RDI, R8, R9, R10, R11 };
+static const enum reg CALLEE_ORDER[] = { RBX, R12, R13, R14, R15 };
+
+// the runtime routines that change less than CALL_CLOBBERS. rt.s saves
+// nothing, so these must match it.
+static const struct {
+    const char *sym;
+    unsigned clobbers;
+} RT_CLOBBERS[] = {
+    // the write syscall's number and arguments, and the rcx and r11 it uses.
+    { "write_newline@", (1u << RAX) | (1u << RCX) | (1u << RDX) | (1u << RSI) | (1u << RDI) | (1u << R11) },
+};
+
+unsigned call_clobbers(const char *sym) {
+    for (size_t k = 0; k < sizeof(RT_CLOBBERS) / sizeof(*RT_CLOBBERS); k++) {
+        if (strcmp(RT_CLOBBERS[k].sym, sym) == 0) return RT_CLOBBERS[k].clobbers;
+    }
+    return CALL_CLOBBERS;
+}
+
+struct interval {
+    int v;
+    // the kth instruction in layout order reads its operands at 2k and
+    // writes its result at 2k+1, so a value can take the register of one
+    // that's last used where it's defined.
+    int start, end;
+    unsigned clobbered; // by the calls made while it's live
+    enum reg reg;
+};
+
+// the kth register an instruction reads, or IR_NONE; there are 3 + nargs.
+static int use_at(struct ir_insn *i, int k) {
+    return k == 0 ? i->a : k == 1 ? i->b : k == 2 ? i->index : i->args[k - 3];
+}
+
+static bool fits_imm32(long n) {
+    return n >= INT32_MIN && n <= INT32_MAX;
+}
+
+static void extend(struct interval *iv, int pos) {
+    if (pos < iv->start) iv->start = pos;
+    if (pos > iv->end) iv->end = pos;
+}
+
+static int by_start(const void *a, const void *b) {
+    const struct interval *x = *(struct interval *const *) a, *y = *(struct interval *const *) b;
+    return x->start != y->start ? (x->start > y->start) - (x->start < y->start) : x->v - y->v;
+}
+
+#define BIT(set, k) ((set)[(k) / 64] & (1ull << ((k) % 64)))
+#define SET(set, k) ((set)[(k) / 64] |= 1ull << ((k) % 64))
+
+// which registers that live in more than one block are live on entry to and
+// exit from each, to a fixed point. global[v] is v's bit, or -1.
+static void liveness(struct ir_func *fn, int *layout, int *global, int words, uint64_t *in, uint64_t *out) {
+    size_t nb = fn->blocks->length;
+    uint64_t *use = xcalloc(nb * words * sizeof(*use));
+    uint64_t *def = xcalloc(nb * words * sizeof(*def));
+
+    for (size_t b = 0; b < nb; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        uint64_t *u = use + b * words, *d = def + b * words;
+        for (size_t j = 0; j < bl->length; j++) {
+            struct ir_insn *i = &bl->insns[j];
+            for (int k = 0; k < 3 + i->nargs; k++) {
+                int v = use_at(i, k);
+                if (v != IR_NONE && global[v] >= 0 && !BIT(d, global[v])) SET(u, global[v]);
+            }
+            if (i->dst != IR_NONE && global[i->dst] >= 0) SET(d, global[i->dst]);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = nb; b-- > 0;) {
+            struct ir_block *bl = fn->blocks->data[b];
+            uint64_t *o = out + b * words, *n = in + b * words;
+            int succ[2] = { IR_NONE, IR_NONE };
+            struct ir_insn *last = bl->length ? &bl->insns[bl->length - 1] : NULL;
+            if (last && ir_is_terminator(last->op)) {
+                if (last->target != IR_NONE) succ[0] = layout[last->target];
+                if (last->target2 != IR_NONE) succ[1] = layout[last->target2];
+            } else if (b + 1 < nb) {
+                succ[0] = b + 1;
+            }
+            for (int s = 0; s < 2; s++) {
+                if (succ[s] == IR_NONE) continue;
+                for (int w = 0; w < words; w++) o[w] |= in[succ[s] * words + w];
+            }
+            for (int w = 0; w < words; w++) {
+                uint64_t x = use[b * words + w] | (o[w] & ~def[b * words + w]);
+                if (x != n[w]) {
+                    n[w] = x;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    D(def);
+    D(use);
+}
+
+// the next free register of order's, or -1.
+static int pick(unsigned free, const enum reg *order, int n) {
+    for (int k = 0; k < n; k++) {
+        if (free & (1u << order[k])) return order[k];
+    }
+    return -1;
+}
+
+// what the calls made while iv is live change: those that read their
+// operands at or after its start and return before its end. calls[k] is the
+// kth call's position, and clobbers[k] what it changes.
+static unsigned clobbered_during(struct interval *iv, int *calls, unsigned *clobbers, int ncalls) {
+    int lo = 0, hi = ncalls;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (2 * calls[mid] < iv->start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    unsigned m = 0;
+    for (int k = lo; k < ncalls && 2 * calls[k] + 2 <= iv->end && m != CALL_CLOBBERS; k++) {
+        m |= clobbers[k];
+    }
+    return m;
+}
+
+static void spill(struct alloc *al, struct interval *iv) {
+    al->locs[iv->v].kind = LOC_STACK;
+    al->locs[iv->v].n = al->num_spills++;
+}
+
+void regalloc(struct ir_func *fn, struct alloc *al) {
+    int nv = fn->num_vregs;
+    size_t nb = fn->blocks->length;
+    al->locs = xcalloc((nv + 1) * sizeof(*al->locs));
+    al->num_spills = 0;
+    al->saved = 0;
+
+    // number the instructions, and note where each value's first defined and
+    // whether it's used in any other block. constants and frame addresses
+    // are put in place wherever they're used, so they don't take part.
+    int *layout = xcalloc(fn->num_blocks * sizeof(*layout));
+    int *first = xcalloc(nb * sizeof(*first)), *last = xcalloc(nb * sizeof(*last));
+    int *def_block = xcalloc((nv + 1) * sizeof(*def_block));
+    int *global = xcalloc((nv + 1) * sizeof(*global));
+    for (int v = 0; v < nv; v++) {
+        def_block[v] = -1;
+        global[v] = ir_is_local(fn, v) ? 0 : -1;
+    }
+    int npos = 0, ncalls = 0;
+    for (size_t b = 0; b < nb; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        layout[bl->id] = b;
+        first[b] = npos;
+        npos += bl->length;
+        last[b] = bl->length ? npos - 1 : npos;
+        for (size_t j = 0; j < bl->length; j++) {
+            struct ir_insn *i = &bl->insns[j];
+            for (int k = 0; k < 3 + i->nargs; k++) {
+                int v = use_at(i, k);
+                if (v != IR_NONE && def_block[v] != (int) b) global[v] = 0;
+            }
+            if (i->op == IR_CALL) ncalls++;
+            if (i->dst == IR_NONE || ir_is_local(fn, i->dst)) continue;
+            if (def_block[i->dst] < 0) def_block[i->dst] = b;
+            if (i->op == IR_CONST && fits_imm32(i->imm)) {
+                al->locs[i->dst].kind = LOC_CONST;
+                al->locs[i->dst].n = i->imm;
+            } else if (i->op == IR_FRAME) {
+                al->locs[i->dst].kind = LOC_FRAME;
+                al->locs[i->dst].n = i->imm;
+            }
+        }
+    }
+
+    int num_globals = 0;
+    for (int v = 0; v < nv; v++) {
+        global[v] = global[v] == 0 && al->locs[v].kind == LOC_NONE ? num_globals++ : -1;
+    }
+    int words = (num_globals + 63) / 64;
+    uint64_t *in = xcalloc(nb * words * sizeof(*in));
+    uint64_t *out = xcalloc(nb * words * sizeof(*out));
+    liveness(fn, layout, global, words, in, out);
+
+    // the intervals: every definition and use, and the blocks each value is
+    // live into or out of. and the calls, in order.
+    struct interval *ivs = xcalloc((nv + 1) * sizeof(*ivs));
+    int *calls = xcalloc((ncalls + 1) * sizeof(*calls));
+    unsigned *clobbers = xcalloc((ncalls + 1) * sizeof(*clobbers));
+    for (int v = 0; v < nv; v++) {
+        ivs[v].v = v;
+        ivs[v].start = INT_MAX;
+        ivs[v].end = -1;
+    }
+    int pos = 0;
+    ncalls = 0;
+    for (size_t b = 0; b < nb; b++) {
+        struct ir_block *bl = fn->blocks->data[b];
+        for (size_t j = 0; j < bl->length; j++, pos++) {
+            struct ir_insn *i = &bl->insns[j];
+            if (i->op == IR_CALL) {
+                calls[ncalls] = pos;
+                clobbers[ncalls++] = call_clobbers(i->sym);
+            }
+            for (int k = 0; k < 3 + i->nargs; k++) {
+                int v = use_at(i, k);
+                if (v != IR_NONE) extend(&ivs[v], 2 * pos);
+            }
+            if (i->dst != IR_NONE) extend(&ivs[i->dst], 2 * pos + 1);
+        }
+    }
+    for (int v = 0; v < nv; v++) {
+        if (global[v] < 0) continue;
+        for (size_t b = 0; b < nb; b++) {
+            if (BIT(in + b * words, global[v])) extend(&ivs[v], 2 * first[b]);
+            if (BIT(out + b * words, global[v])) extend(&ivs[v], 2 * last[b] + 1);
+        }
+    }
+
+    struct interval **order = xcalloc((nv + 1) * sizeof(*order));
+    int n = 0;
+    for (int v = 0; v < nv; v++) {
+        struct interval *iv = &ivs[v];
+        if (iv->end < 0 || al->locs[v].kind != LOC_NONE) continue;
+        iv->clobbered = clobbered_during(iv, calls, clobbers, ncalls);
+        order[n++] = iv;
+    }
+    qsort(order, n, sizeof(*order), by_start);
+
+    // the scan, with active kept sorted by end.
+    struct interval **active = xcalloc((NUM_REGS + 1) * sizeof(*active));
+    int nactive = 0;
+    unsigned free = CALLER_SAVED | CALLEE_SAVED;
+    for (int k = 0; k < n; k++) {
+        struct interval *iv = order[k];
+        int expired = 0;
+        while (expired < nactive && active[expired]->end < iv->start) {
+            free |= 1u << active[expired]->reg;
+            expired++;
+        }
+        memmove(active, active + expired, (nactive - expired) * sizeof(*active));
+        nactive -= expired;
+
+        // the registers no call changes while it's live.
+        unsigned ok = (CALLER_SAVED | CALLEE_SAVED) & ~iv->clobbered;
+        int r = pick(free & ok, CALLER_ORDER, 6);
+        if (r < 0) r = pick(free & ok, CALLEE_ORDER, 5);
+        if (r < 0) {
+            // none free: of those it could have, the one needed furthest
+            // ahead goes to the stack, which may be this one.
+            int victim = -1;
+            for (int a = nactive; a-- > 0;) {
+                if (ok & (1u << active[a]->reg)) {
+                    victim = a;
+                    break;
+                }
+            }
+            if (victim < 0 || active[victim]->end <= iv->end) {
+                spill(al, iv);
+                continue;
+            }
+            r = active[victim]->reg;
+            spill(al, active[victim]);
+            memmove(active + victim, active + victim + 1, (nactive - victim - 1) * sizeof(*active));
+            nactive--;
+            free |= 1u << r;
+        }
+
+        iv->reg = r;
+        free &= ~(1u << r);
+        if (CALLEE_SAVED & (1u << r)) al->saved |= 1u << r;
+        al->locs[iv->v].kind = LOC_REG;
+        al->locs[iv->v].n = r;
+        int a = nactive++;
+        while (a > 0 && active[a - 1]->end > iv->end) {
+            active[a] = active[a - 1];
+            a--;
+        }
+        active[a] = iv;
+    }
+
+    D(active);
+    D(order);
+    D(clobbers);
+    D(calls);
+    D(ivs);
+    D(out);
+    D(in);
+    D(global);
+    D(def_block);
+    D(last);
+    D(first);
+    D(layout);
+}
@@ -0,0 +1,59 @@
+#ifndef _REGALLOC_H
+#define _REGALLOC_H
+
+#include "ir.h"
+
+/* Where codegen keeps each virtual register of a function: linear scan over
+ * live intervals (Poletto and Sarkar). Liveness is worked out over the
+ * blocks, so an interval runs from a value's first definition to its last
+ * use, all the way round any loop it's live in. Values live across a call
+ * get registers it leaves alone, callee-saved ones if need be; the rest
+ * prefer the caller-saved ones, which cost nothing to use. When registers
+ * run out, the value needed furthest ahead goes to the stack. Constants and
+ * addresses in the frame aren't kept anywhere: codegen puts them straight
+ * into the instructions using them. */
+
+// the x86-64 registers, numbered as the encoding has them.
+enum reg {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    NUM_REGS,
+};
+
+extern const char *REG_NAMES[NUM_REGS];
+// the low byte of each.
+extern const char *REG_BYTE_NAMES[NUM_REGS];
+
+// rbx and r12-r15 survive calls: whoever uses them saves them. rax, rcx and
+// rdx are codegen's scratch (and idiv's), and rsp and rbp the frame's.
+#define CALLEE_SAVED ((1u << RBX) | (1u << R12) | (1u << R13) | (1u << R14) | (1u << R15))
+#define CALLER_SAVED ((1u << RSI) | (1u << RDI) | (1u << R8) | (1u << R9) | (1u << R10) | (1u << R11))
+// what a call may change, unless its callee says otherwise.
+#define CALL_CLOBBERS (CALLER_SAVED | (1u << RAX) | (1u << RCX) | (1u << RDX))
+
+// the registers a call to sym may change: CALL_CLOBBERS for our subprograms,
+// and for the runtime's (rt.s), what each is written to keep to.
+unsigned call_clobbers(const char *sym);
+
+enum loc_kind {
+    LOC_NONE,  // never defined
+    LOC_REG,   // register n
+    LOC_STACK, // spill slot n
+    LOC_CONST, // the constant n, which fits in 32 bits
+    LOC_FRAME, // the address rbp+n
+};
+
+struct loc {
+    enum loc_kind kind;
+    long n;
+};
+
+struct alloc {
+    struct loc *locs; // of each virtual register
+    int num_spills;   // 8-byte slots
+    unsigned saved;   // the callee-saved registers used, 1 << reg each
+};
+
+void regalloc(struct ir_func *, struct alloc *);
+
+#endif
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "report.h"
+
+static double ms_between(struct timespec *a, struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static long peak_rss_kib(void) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return ru.ru_maxrss; // already KiB on Linux
+}
+
+void report_init(struct report *r) {
+    memset(r, 0, sizeof(*r));
+}
+
+void report_begin(struct report *r, struct arena *a) {
+    clock_gettime(CLOCK_MONOTONIC, &r->wall0);
+    // this thread's time only, so -j doesn't count the other jobs.
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &r->cpu0);
+    r->allocs0 = a->allocs;
+    r->bytes0 = a->bytes;
+}
+
+void report_end(struct report *r, const char *name, struct arena *a) {
+    struct timespec wall, cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    if (r->num_phases == MAX_PHASES) return;
+
+    struct phase *p = &r->phases[r->num_phases++];
+    p->name = name;
+    p->wall_ms = ms_between(&r->wall0, &wall);
+    p->cpu_ms = ms_between(&r->cpu0, &cpu);
+    // a reset zeroes the counters; that phase allocated nothing.
+    p->allocs = a->allocs >= r->allocs0 ? a->allocs - r->allocs0 : 0;
+    p->bytes = a->bytes >= r->bytes0 ? a->bytes - r->bytes0 : 0;
+    p->peak_rss_kib = peak_rss_kib();
+}
+
+static void total(struct report *r, struct phase *t) {
+    memset(t, 0, sizeof(*t));
+    t->name = "total";
+    for (int i = 0; i < r->num_phases; i++) {
+        t->wall_ms += r->phases[i].wall_ms;
+        t->cpu_ms += r->phases[i].cpu_ms;
+        t->allocs += r->phases[i].allocs;
+        t->bytes += r->phases[i].bytes;
+    }
+    t->peak_rss_kib = peak_rss_kib();
+}
+
+static void print_phase_row(FILE *f, struct phase *p) {
+    fprintf(f, "  %-10s %10.3f %10.3f %10zu %12zu %10ld\n", p->name, p->wall_ms,
+            p->cpu_ms, p->allocs, p->bytes, p->peak_rss_kib);
+}
+
+static void print_phase_json(FILE *f, struct phase *p) {
+    fprintf(f, "{\"name\":\"%s\",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"allocs\":%zu,"
+            "\"bytes\":%zu,\"peak_rss_kib\":%ld}", p->name, p->wall_ms, p->cpu_ms,
+            p->allocs, p->bytes, p->peak_rss_kib);
+}
+
+// names are paths, which can hold anything but a NUL.
+static void print_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if ((unsigned char) *s < 0x20) {
+            fprintf(f, "\\u%04x", *s);
+            continue;
+        }
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+void report_print(struct report *r, const char *name, bool json) {
+    struct phase t;
+    total(r, &t);
+    struct ast_counts *c = &r->ast;
+
+    // one report at a time, with -j.
+    flockfile(stderr);
+    if (json) {
+        fputs("{\"file\":", stderr);
+        if (name) {
+            print_json_string(stderr, name);
+        } else {
+            fputs("null", stderr);
+        }
+        fputs(",\"phases\":[", stderr);
+        for (int i = 0; i < r->num_phases; i++) {
+            if (i) fputc(',', stderr);
+            print_phase_json(stderr, &r->phases[i]);
+        }
+        fputs("],\"total\":", stderr);
+        print_phase_json(stderr, &t);
+        fprintf(stderr, ",\"ast\":{\"nodes\":%zu,\"subprograms\":%zu,\"decls\":%zu,"
+                "\"statements\":%zu,\"expressions\":%zu,\"types\":%zu,\"idents\":%zu},"
+                "\"stab\":{\"scopes\":%zu,\"vars\":%zu,\"types\":%zu,"
+                "\"path_hits\":%zu,\"path_misses\":%zu},\"peep\":{",
+                ast_counts_total(c), c->subprogs, c->decls, c->stmts, c->exprs,
+                c->types, r->idents, r->scopes, r->vars, r->types, r->path_hits,
+                r->path_misses);
+        for (int i = 0; i < NUM_PEEP_RULES; i++) {
+            fprintf(stderr, "%s\"%s\":%ld", i ? "," : "", PEEP_NAMES[i], r->peep[i]);
+        }
+        fputs("}}\n", stderr);
+    } else {
+        fprintf(stderr, "time report%s%s:\n", name ? " for " : "", name ? name : "");
+        fprintf(stderr, "  %-10s %10s %10s %10s %12s %10s\n", "phase", "wall ms",
+                "cpu ms", "allocs", "bytes", "peak KiB");
+        for (int i = 0; i < r->num_phases; i++) {
+            print_phase_row(stderr, &r->phases[i]);
+        }
+        print_phase_row(stderr, &t);
+        fprintf(stderr, "  ast: %zu nodes (%zu subprograms, %zu decls, %zu statements, "
+                "%zu expressions, %zu types), %zu idents\n", ast_counts_total(c),
+                c->subprogs, c->decls, c->stmts, c->exprs, c->types, r->idents);
+        fprintf(stderr, "  stab: %zu scopes, %zu vars, %zu types\n", r->scopes,
+                r->vars, r->types);
+        fprintf(stderr, "  path cache: %zu hits, %zu misses\n", r->path_hits,
+                r->path_misses);
+        fputs("  peephole:", stderr);
+        for (int i = 0; i < NUM_PEEP_RULES; i++) {
+            fprintf(stderr, "%s %s %ld", i ? "," : "", PEEP_NAMES[i], r->peep[i]);
+        }
+        fputc('\n', stderr);
+    }
+    funlockfile(stderr);
+}
@@ -0,0 +1,44 @@
+#ifndef _REPORT_H
+#define _REPORT_H
+
+#include <time.h>
+
+#include "ast.h"
+#include "peep.h"
+#include "util.h"
+
+/* The -t (and -T, as JSON) report: what each phase of a compile cost, and how
+ * big the program came out. Allocations are the arena's, which is where
+ * nearly everything lives; peak RSS is the whole process's. */
+
+#define MAX_PHASES 8
+
+struct phase {
+    const char *name;
+    double wall_ms, cpu_ms;
+    size_t allocs, bytes;
+    long peak_rss_kib; // as of the end of the phase
+};
+
+struct report {
+    struct phase phases[MAX_PHASES];
+    int num_phases;
+
+    struct ast_counts ast;
+    size_t idents;
+    size_t scopes, vars, types;
+    size_t path_hits, path_misses;
+    long peep[NUM_PEEP_RULES]; // how often each peephole rule applied
+
+    // where the running phase started.
+    struct timespec wall0, cpu0;
+    size_t allocs0, bytes0;
+};
+
+void report_init(struct report *);
+void report_begin(struct report *, struct arena *);
+void report_end(struct report *, const char *phase, struct arena *);
+// print to stderr, as a table or as one line of JSON.
+void report_print(struct report *, const char *name, bool json);
+
+#endif
@@ -22,11 +22,10 @@ extern stdout
 ; al = 0, rdi = arg0, rsi = arg1, since our arguments are all in the INTEGER
 ; class (for now). rax gets clobbered, as the retval.
 
-; We need to save: rax, rdi, rsi, rdx, rcx, r8, r9, r10, r11. The compiler
-; should be modified to save these on-demand.
-
-; Calling convention for these: [rsp+8] is the value to be printed. All
-; registers are callee-save.
+; Calling convention for these: [rsp+8] is the value to be printed. Like the
+; compiled code, they keep rbx, rbp and r12-r15 and may change the rest (see
+; CALL_CLOBBERS in regalloc.h), so they save nothing. One that changes less
+; says so in RT_CLOBBERS in regalloc.c, and must keep to it.
 
 SECTION .data
 
@@ -37,48 +36,28 @@ percent_s_cstr: db '%s',0
 SECTION .text
 
 write_integer@:
-    push rsi
-    mov rsi, [rsp+16]
-    push rax
-    push rdi
-    push rdx
-    push rcx
-    push r8
-    push r9
-    push r10
-    push r11
+    mov rsi, [rsp+8]
 
+    ; the sysv abi wants rsp 16-byte aligned at the call, and the compiled
+    ; code only keeps it 8-byte aligned.
+    push rbp
+    mov rbp, rsp
+    and rsp, -16
     xor rax, rax
     mov rdi, percent_ld_cstr
     call printf
     mov rdi, [stdout]
     call fflush
-
-    pop r11
-    pop r10
-    pop r9
-    pop r8
-    pop rcx
-    pop rdx
-    pop rdi
-    pop rax
-    pop rsi
+    mov rsp, rbp
+    pop rbp
     ret
 
+; changes rax, rdi, rsi and rdx, the syscall's, and rcx and r11, which the
+; syscall does.
 write_newline@:
-    push rax ; rax is the retv for sysv.
-    push rdi
-    push rsi
-    push rdx
-
     mov rax, 1 ; write
     mov rdi, 1 ; stdout
     mov rsi, newline
     mov rdx, 1 ; only writing 1 byte
     syscall
-
-    pop rdx
-    pop rsi
-    pop rdi
-    pop rax
     ret
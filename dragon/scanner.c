@@ -0,0 +1,230 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scanner.h"
+#include "util.h"
+
+/* Hand-written replacement for the flex lexer. It produces exactly the tokens
+ * lexer.l does, but scans the source buffer in place instead of copying it,
+ * and skips whitespace, comments and identifier bodies 16 bytes at a time
+ * with SSE2 where it can. Keywords are recognised with a perfect hash. */
+
+struct scanner {
+    const char *src, *p, *end;
+};
+
+struct keyword {
+    const char *name;
+    size_t len;
+    int tok;
+};
+
+// indexed by KEYWORD_HASH, which has no collisions among the keywords.
+#define KEYWORD_HASH(s, len) \
+    ((((unsigned char)(s)[0] * 3) ^ ((unsigned char)(s)[(len) - 1] * 7) ^ ((len) << 4)) & 63)
+
+static const struct keyword KEYWORDS[64] = {
+    [3] = { "procedure", 9, PROCEDURE },
+    [5] = { "do", 2, DO },
+    [10] = { "record", 6, RECORD },
+    [11] = { "mod", 3, MOD },
+    [12] = { "var", 3, VAR },
+    [17] = { "if", 2, IF },
+    [20] = { "boolean", 7, BOOLEAN },
+    [21] = { "integer", 7, INTEGER },
+    [22] = { "not", 3, NOT },
+    [27] = { "program", 7, PROGRAM },
+    [28] = { "for", 3, FOR },
+    [30] = { "then", 4, THEN },
+    [31] = { "type", 4, TYPE },
+    [34] = { "real", 4, REAL },
+    [35] = { "end", 3, END },
+    [38] = { "div", 3, DIV },
+    [39] = { "of", 2, OF },
+    [40] = { "string", 6, STRING },
+    [44] = { "else", 4, ELSE },
+    [47] = { "and", 3, AND },
+    [48] = { "function", 8, FUNCTION },
+    [51] = { "or", 2, OR },
+    [52] = { "begin", 5, TBEGIN },
+    [53] = { "to", 2, TO },
+    [54] = { "while", 5, WHILE },
+    [55] = { "char", 4, CHAR },
+    [60] = { "array", 5, ARRAY },
+};
+
+static int keyword(const char *s, size_t len) {
+    if (len < 2 || len > 9) return ID;
+    const struct keyword *k = &KEYWORDS[KEYWORD_HASH(s, len)];
+    if (k->len == len && memcmp(k->name, s, len) == 0) {
+        return k->tok;
+    }
+    return ID;
+}
+
+static inline bool is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_ident(char c) {
+    return is_ident_start(c) || is_digit(c);
+}
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+#ifdef __SSE2__
+// 0xff in each byte of v that lies in [lo, hi].
+static inline __m128i in_range(__m128i v, char lo, char hi) {
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(hi - lo)), d);
+}
+#endif
+
+// first byte at or after p that isn't whitespace.
+static const char *span_space(const char *p, const char *end) {
+#ifdef __SSE2__
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')),
+                    _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+        uint32_t m = ~_mm_movemask_epi8(ws) & 0xffff;
+        if (m) return p + __builtin_ctz(m);
+    }
+#endif
+    while (p < end && is_space(*p)) p++;
+    return p;
+}
+
+// first byte at or after p that can't continue an identifier.
+static const char *span_ident(const char *p, const char *end) {
+#ifdef __SSE2__
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        // folding case maps no non-letter into a-z.
+        __m128i id = _mm_or_si128(in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'),
+                _mm_or_si128(in_range(v, '0', '9'), _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+        uint32_t m = ~_mm_movemask_epi8(id) & 0xffff;
+        if (m) return p + __builtin_ctz(m);
+    }
+#endif
+    while (p < end && is_ident(*p)) p++;
+    return p;
+}
+
+static const char *span_digits(const char *p, const char *end) {
+    while (p < end && is_digit(*p)) p++;
+    return p;
+}
+
+// [0-9]+(\.[0-9]+)?([eE](\+|\-)?[0-9]+)?, taking the optional parts only
+// when they are complete, like flex's longest match does.
+static const char *span_number(const char *p, const char *end) {
+    p = span_digits(p, end);
+    if (end - p >= 2 && p[0] == '.' && is_digit(p[1])) {
+        p = span_digits(p + 1, end);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        if (q < end && (*q == '+' || *q == '-')) q++;
+        if (q < end && is_digit(*q)) {
+            p = span_digits(q, end);
+        }
+    }
+    return p;
+}
+
+// the token [start, to) begins at start; move past it.
+static void take(struct scanner *sc, YYLTYPE *loc, const char *start, const char *to) {
+    loc->offset = start - sc->src;
+    sc->p = to;
+}
+
+int scan_lex(YYSTYPE *yylval, YYLTYPE *yylloc, void *scanner) {
+    struct scanner *sc = scanner;
+    const char *end = sc->end;
+
+    for (;;) {
+        sc->p = span_space(sc->p, end);
+        const char *p = sc->p;
+        if (p == end) {
+            return 0;
+        }
+
+        const char *close;
+        if (*p == '{') {
+            close = memchr(p + 1, '}', end - p - 1);
+        } else if (*p == '(' && end - p >= 2 && p[1] == '*') {
+            close = p + 1;
+            do {
+                close = memchr(close + 1, '*', end - close - 1);
+            } while (close && close + 1 < end && close[1] != ')');
+            if (close && close + 1 == end) close = NULL;
+            if (close) close++;
+        } else if (*p == '/' && end - p >= 2 && p[1] == '/') {
+            // runs to the end of the line, leaving the newline.
+            close = memchr(p, '\n', end - p);
+            sc->p = close ? close : end;
+            continue;
+        } else {
+            break;
+        }
+
+        if (!close) {
+            take(sc, yylloc, p, end);
+            span_diag("unterminated comment at end of input", yylloc);
+            return YYUNDEF;
+        }
+        sc->p = close + 1;
+    }
+
+    const char *start = sc->p, *p = start;
+    int tok;
+    if (is_ident_start(*p)) {
+        p = span_ident(p + 1, end);
+        tok = keyword(start, p - start);
+        if (tok == ID) {
+            yylval->name = intern(start, p - start);
+        }
+    } else if (is_digit(*p)) {
+        p = span_number(p, end);
+        tok = NUM;
+        yylval->name = intern(start, p - start);
+    } else {
+        char next = end - p >= 2 ? p[1] : '\0';
+        tok = 0;
+        switch (*p) {
+            case ':': if (next == '=') tok = ASSIGNOP; break;
+            case '<': if (next == '>') tok = NEQ; else if (next == '=') tok = LE; break;
+            case '>': if (next == '=') tok = GE; break;
+            case '.': if (next == '.') tok = DOTDOT; break;
+        }
+        if (tok) {
+            p += 2;
+        } else {
+            tok = *p++;
+        }
+    }
+
+    take(sc, yylloc, start, p);
+    return tok;
+}
+
+void *scanner_new(char *src, size_t len) {
+    struct scanner *sc = M(struct scanner);
+    sc->src = sc->p = src;
+    sc->end = src + len;
+    return sc;
+}
+
+void scanner_free(void *scanner) {
+    D(scanner);
+}
@@ -0,0 +1,22 @@
+#ifndef _SCANNER_H
+#define _SCANNER_H
+
+#include <stdlib.h>
+#include "parser.tab.h"
+
+/* The lexer interface the parser and driver see. It's either the flex lexer
+ * (lexer.l) or the hand-written scanner (scanner.c), chosen at build time by
+ * USE_FLEX. Both produce the same tokens. */
+
+#ifdef USE_FLEX
+#include "lexer.h"
+#else
+int scan_lex(YYSTYPE *, YYLTYPE *, void *);
+#define yylex scan_lex
+#endif
+
+// Start scanning len bytes at src, which must outlive the scanner.
+void *scanner_new(char *src, size_t len);
+void scanner_free(void *);
+
+#endif
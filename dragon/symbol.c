@@ -2,30 +2,28 @@
 #include "util.h"
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
 
-static bool streq(char *a, char *b) {
-    return strcmp(a, b) == 0;
-}
+static uint64_t hash_stab_type(void *);
+static bool compare_stab_type(void *, void *);
 
-static int64_t hash_string(char *s) {
-    return hashpjw(s, strlen(s));
+static void free_path_cache(struct stab_scope *sc) {
+    if (sc->path_ty_cache) hash_free(sc->path_ty_cache);
+    sc->path_ty_cache = NULL;
 }
 
 static void free_stab_scope(struct stab_scope *sc) {
-    hash_free(sc->vars);
-    hash_free(sc->funcs);
-    hash_free(sc->types);
+    free_path_cache(sc);
+    ptrvec_free(sc->vars);
     D(sc);
 };
 
 static void free_stab_var(struct stab_var *v) {
-    D(v->name);
     D(v->defn);
     D(v);
 }
 
 static void free_stab_type(struct stab_type *t) {
-    D(t->name);
     D(t->defn);
     switch (t->ty.tag) {
         case TYPE_RECORD:
@@ -42,23 +40,13 @@ static void free_stab_type(struct stab_type *t) {
     D(t);
 }
 
-static struct stab_scope *stab_scope_new() {
+static struct stab_scope *stab_scope_new(struct stab *st) {
     struct stab_scope *sc = M(struct stab_scope);
-    sc->vars = hash_new(1 << 8, (HASH_FUNC) hash_string, (COMPARE_FUNC) streq,
-            (FREE_FUNC) dummy_free, (FREE_FUNC) dummy_free);
-    sc->funcs = hash_new(1 << 8, (HASH_FUNC) hash_string, (COMPARE_FUNC) streq,
-            (FREE_FUNC) dummy_free, (FREE_FUNC) dummy_free);
-    sc->types = hash_new(1 << 8, (HASH_FUNC) hash_string, (COMPARE_FUNC) streq,
-            (FREE_FUNC) dummy_free, (FREE_FUNC) dummy_free);
-    /*
-    sc->expr_ty_cache = hash_new(1 << 8, (HASH_FUNC) hash_expr,
-            (COMPARE_FUNC) ptreq, (FREE_FUNC) dummy_free,
-            (FREE_FUNC) dummy_free);
-    sc->path_ty_cache = hash_new(1 << 8, (HASH_FUNC) hash_path,
-            (COMPARE_FUNC) patheq, (FREE_FUNC) dummy_free,
-            (FREE_FUNC) dummy_free);
-    */
-
+    sc->vars = ptrvec_wcap(0, CB dummy_free);
+    sc->depth = st->chain->length + 1;
+    sc->undo_mark = st->undo->length;
+    // made on first use: most scopes never touch a field.
+    sc->path_ty_cache = NULL;
     return sc;
 }
 
@@ -69,6 +57,15 @@ struct stab *stab_new() {
     s->vars = ptrvec_wcap(1 << 8, CB free_stab_var);
     s->types = ptrvec_wcap(1 << 8, CB free_stab_type);
     s->scopes = ptrvec_wcap(1 << 8, CB free_stab_scope);
+    s->undo = ptrvec_wcap(1 << 8, CB dummy_free);
+    // the types own themselves, through s->types.
+    s->interned = hash_new(1 << 6, hash_stab_type, compare_stab_type,
+            (FREE_FUNC) dummy_free, (FREE_FUNC) dummy_free);
+    for (int ns = 0; ns < NUM_NS; ns++) {
+        // keyed by ident, so no key needs freeing or string comparing.
+        s->names[ns] = hash_new(1 << 8, hash_ident, compare_pointer,
+                (FREE_FUNC) dummy_free, (FREE_FUNC) dummy_free);
+    }
 
     // int, real, str, bool, char, void
     struct stab_resolved_type rt;
@@ -76,38 +73,32 @@ struct stab *stab_new() {
 
     rt.tag = TYPE_INTEGER;
     t = M(struct stab_type);
-    // XHAZARD
-    t->name = strdup("integer"); t->defn = NULL; t->size = 8; t->align = 8; t->ty = rt;
+    t->name = intern_cstr("integer"); t->defn = NULL; t->size = 8; t->align = 8; t->ty = rt;
     ptrvec_push(s->types, t);
 
     rt.tag = TYPE_REAL;
     t = M(struct stab_type);
-    // XHAZARD
-    t->name = strdup("real"); t->defn = NULL; t->size = 8; t->align = 8; t->ty = rt;
+    t->name = intern_cstr("real"); t->defn = NULL; t->size = 8; t->align = 8; t->ty = rt;
     ptrvec_push(s->types, t);
 
     rt.tag = TYPE_STRING;
     t = M(struct stab_type);
-    // XHAZARD
-    t->name = strdup("string"); t->defn = NULL; t->size = ABI_POINTER_SIZE; t->align =ABI_POINTER_ALIGN; t->ty = rt;
+    t->name = intern_cstr("string"); t->defn = NULL; t->size = ABI_POINTER_SIZE; t->align =ABI_POINTER_ALIGN; t->ty = rt;
     ptrvec_push(s->types, t);
 
     rt.tag = TYPE_BOOLEAN;
     t = M(struct stab_type);
-    // XHAZARD
-    t->name = strdup("boolean"); t->defn = NULL; t->size = 1; t->align = 1; t->ty = rt;
+    t->name = intern_cstr("boolean"); t->defn = NULL; t->size = 1; t->align = 1; t->ty = rt;
     ptrvec_push(s->types, t);
 
     rt.tag = TYPE_CHAR;
     t = M(struct stab_type);
-    // XHAZARD
-    t->name = strdup("char"); t->defn = NULL; t->size = 1; t->align = 1; t->ty = rt;
+    t->name = intern_cstr("char"); t->defn = NULL; t->size = 1; t->align = 1; t->ty = rt;
     ptrvec_push(s->types, t);
 
     rt.tag = TYPE_VOID;
     t = M(struct stab_type);
-    // XHAZARD
-    t->name = strdup("<void>"); t->defn = NULL; t->size = 4; t->align = 4; t->ty = rt;
+    t->name = intern_cstr("<void>"); t->defn = NULL; t->size = 4; t->align = 4; t->ty = rt;
     ptrvec_push(s->types, t);
 
     return s;
@@ -115,6 +106,11 @@ struct stab *stab_new() {
 
 void stab_free(struct stab *st) {
     list_free(st->chain);
+    for (int ns = 0; ns < NUM_NS; ns++) {
+        hash_free(st->names[ns]);
+    }
+    ptrvec_free(st->undo);
+    hash_free(st->interned);
     ptrvec_free(st->scopes);
     ptrvec_free(st->vars);
     ptrvec_free(st->types);
@@ -123,60 +119,92 @@ void stab_free(struct stab *st) {
 
 void stab_enter(struct stab *st) {
     // create empty stab_scope, push onto the chain
-    struct stab_scope *sc = stab_scope_new();
+    struct stab_scope *sc = stab_scope_new(st);
     list_add(st->chain, sc);
     ptrvec_push(st->scopes, YOLO sc);
     return;
 }
 
 void stab_leave(struct stab *st) {
-    list_pop(st->chain);
+    struct stab_scope *sc = list_pop(st->chain);
+    // unwind every binding made in this scope, innermost first.
+    while (st->undo->length > sc->undo_mark) {
+        struct stab_binding *b = ptrvec_pop(st->undo);
+        hash_insert(st->names[b->ns], IDENT_P(b->name), YOLO b->shadowed);
+        D(b);
+    }
+    // nothing is looked up in this scope again.
+    free_path_cache(sc);
     return;
 }
 
-size_t stab_resolve_type_name(struct stab *st, char *name) {
-    LFOREACHREV(struct stab_scope *sc, st->chain)
-        size_t id = (size_t) hash_lookup(sc->types, YOLO name);
-        if (id == -1) {
-            continue;
-        } else {
-            return id;
-        }
-    ENDLFOREACHREV;
+// the innermost binding of name, or NULL.
+static struct stab_binding *stab_lookup(struct stab *st, enum stab_ns ns, ident name) {
+    struct stab_binding *b = hash_lookup(st->names[ns], IDENT_P(name));
+    return b == (void *)-1 ? NULL : b;
+}
 
-    // didn't find anything
-    return RESOLVE_FAILURE;
+static void stab_bind(struct stab *st, enum stab_ns ns, ident name, size_t idx) {
+    struct stab_binding *b = M(struct stab_binding);
+    b->idx = idx;
+    b->name = name;
+    b->ns = ns;
+    b->depth = st->chain->length;
+    b->shadowed = stab_lookup(st, ns, name);
+    hash_insert(st->names[ns], IDENT_P(name), YOLO b);
+    ptrvec_push(st->undo, YOLO b);
+    // the new name may shadow something the cached paths were resolved
+    // through.
+    struct stab_scope *sc = list_last(st->chain);
+    if (sc) free_path_cache(sc);
 }
 
-size_t stab_resolve_func(struct stab *st, char *name) {
-    LFOREACHREV(struct stab_scope *sc, st->chain)
-        size_t id = (size_t) hash_lookup(sc->funcs, YOLO name);
-        if (id == -1) {
-            continue;
-        } else {
-            return id;
-        }
-    ENDLFOREACHREV;
+struct stab_path_ty *stab_cached_path_ty(struct stab *st, ident path) {
+    struct stab_scope *sc = list_last(st->chain);
+    void *p = sc && sc->path_ty_cache ? hash_lookup(sc->path_ty_cache, IDENT_P(path)) : (void *)-1;
+    if (p == (void *)-1) {
+        st->path_misses++;
+        return NULL;
+    }
+    st->path_hits++;
+    return p;
+}
 
-    // didn't find anything
-    return RESOLVE_FAILURE;
+void stab_cache_path_ty(struct stab *st, ident path, struct stab_path_ty *p) {
+    struct stab_scope *sc = list_last(st->chain);
+    if (!sc) return;
+    if (!sc->path_ty_cache) {
+        sc->path_ty_cache = hash_new(1 << 3, hash_ident, compare_pointer,
+                (FREE_FUNC) dummy_free, CB xfree);
+    }
+    struct stab_path_ty *n = M(struct stab_path_ty);
+    *n = *p;
+    hash_insert(sc->path_ty_cache, IDENT_P(path), n);
 }
 
-size_t stab_resolve_var(struct stab *st, char *name) {
-    LFOREACHREV(struct stab_scope *sc, st->chain)
-        size_t id = (size_t) hash_lookup(sc->vars, YOLO name);
-        if (id == -1) {
-            continue;
-        } else {
-            return id;
-        }
-    ENDLFOREACHREV;
+static size_t stab_resolve(struct stab *st, enum stab_ns ns, ident name) {
+    struct stab_binding *b = stab_lookup(st, ns, name);
+    return b ? b->idx : RESOLVE_FAILURE;
+}
 
-    // didn't find anything
-    return RESOLVE_FAILURE;
+static bool stab_has_local(struct stab *st, enum stab_ns ns, ident name) {
+    struct stab_binding *b = stab_lookup(st, ns, name);
+    return b && b->depth == st->chain->length;
 }
 
-size_t stab_add_var(struct stab *st, char *name, size_t type, YYLTYPE *span, int *curr_var_offset, bool add_to_locals) {
+size_t stab_resolve_type_name(struct stab *st, ident name) {
+    return stab_resolve(st, NS_TYPE, name);
+}
+
+size_t stab_resolve_func(struct stab *st, ident name) {
+    return stab_resolve(st, NS_FUNC, name);
+}
+
+size_t stab_resolve_var(struct stab *st, ident name) {
+    return stab_resolve(st, NS_VAR, name);
+}
+
+size_t stab_add_var(struct stab *st, ident name, size_t type, YYLTYPE *span, int *curr_var_offset, bool add_to_locals) {
     struct stab_scope *sc = list_last(st->chain);
     struct stab_var *v = M(struct stab_var);
     v->type = type;
@@ -184,79 +212,173 @@ size_t stab_add_var(struct stab *st, char *name, size_t type, YYLTYPE *span, int
     v->name = name;
     v->captured = false;
     v->disp_offset = -1;
+    v->vreg = -1;
     if (curr_var_offset) {
-        v->stack_base_offset = *curr_var_offset;
-        // todo: alignment.
-        *curr_var_offset += (add_to_locals ? 1 : -1) * STAB_TYPE(st, type)->size;
+        if (add_to_locals) {
+            // locals go down from the frame pointer, each aligned to its size,
+            // up to 8.
+            struct stab_type *t = STAB_TYPE(st, type);
+            int align = t->align > 8 ? 8 : t->align ? t->align : 1;
+            *curr_var_offset -= t->size;
+            *curr_var_offset &= ~(align - 1);
+            v->stack_base_offset = *curr_var_offset;
+        } else {
+            // arguments are a slot each above the return address, the first
+            // highest.
+            v->stack_base_offset = *curr_var_offset;
+            *curr_var_offset -= ABI_POINTER_SIZE;
+        }
     } else {
         v->stack_base_offset = -1;
     }
 
     size_t id = ptrvec_push(st->vars, YOLO v);
-    hash_insert(sc->vars, YOLO name, YOLO id);
+    ptrvec_push(sc->vars, YOLO id);
+    stab_bind(st, NS_VAR, name, id);
 
     return id;
 }
 
-static struct stab_record_field *stab_record_field(char *name, size_t type) {
+static struct stab_record_field *stab_record_field(ident name, size_t type, uint64_t offset) {
     struct stab_record_field *f = M(struct stab_record_field);
-    f->name = strdup(name);
+    f->name = name;
     f->type = type;
+    f->offset = offset;
     return f;
 }
 
-static void free_stab_record_field(struct stab_record_field *f) {
-    D(f->name);
-    D(f);
+#define MIX(h, x) ((h) = ((h) ^ (uint64_t) (x)) * 0x9e3779b97f4a7c15)
+
+// the parts of a structural type that make it what it is. the components are
+// themselves interned, so comparing their indices is enough.
+static uint64_t hash_stab_type(void *p) {
+    struct stab_type *t = p;
+    uint64_t h = t->ty.tag;
+    switch (t->ty.tag) {
+        case TYPE_POINTER:
+            MIX(h, t->ty.pointer);
+            break;
+        case TYPE_ARRAY:
+            MIX(h, t->ty.array.lower);
+            MIX(h, t->ty.array.upper);
+            MIX(h, t->ty.array.elt_type);
+            break;
+        case TYPE_FUNCTION:
+            MIX(h, t->ty.func.type);
+            MIX(h, t->ty.func.retty);
+            LFOREACH(void *arg, t->ty.func.args)
+                MIX(h, arg);
+            ENDLFOREACH;
+            break;
+        default:
+            abort();
+    }
+    return h;
 }
 
-static size_t stab_resolve_complex_type(struct stab *st, char *name, struct ast_type *ty) {
-    struct stab_type *t = M(struct stab_type);
-    t->defn = NULL;
-    t->name = name;
-    t->ty.tag = ty->tag;
-    t->magic = 0;
+static bool compare_stab_type(void *p, void *q) {
+    struct stab_type *a = p, *b = q;
+    if (a->ty.tag != b->ty.tag) return false;
+    switch (a->ty.tag) {
+        case TYPE_POINTER:
+            return a->ty.pointer == b->ty.pointer;
+        case TYPE_ARRAY:
+            return a->ty.array.lower == b->ty.array.lower
+                && a->ty.array.upper == b->ty.array.upper
+                && a->ty.array.elt_type == b->ty.array.elt_type;
+        case TYPE_FUNCTION:
+            if (a->ty.func.type != b->ty.func.type
+                    || a->ty.func.retty != b->ty.func.retty
+                    || a->ty.func.args->length != b->ty.func.args->length) {
+                return false;
+            }
+            LFOREACH2(void *x, void *y, a->ty.func.args, b->ty.func.args)
+                if (x != y) return false;
+            ENDLFOREACH2;
+            return true;
+        default:
+            abort();
+    }
+}
+
+// the index of the type equal to *t, adding a copy of it if there's none yet.
+// a type that's already there keeps the name it was first made with.
+static size_t stab_intern_type(struct stab *st, struct stab_type *t) {
+    void *found = hash_lookup(st->interned, t);
+    if (found != (void *)-1) {
+        if (t->ty.tag == TYPE_FUNCTION) list_free(t->ty.func.args);
+        return (size_t) found;
+    }
+    struct stab_type *n = M(struct stab_type);
+    *n = *t;
+    size_t idx = ptrvec_push(st->types, YOLO n);
+    hash_insert(st->interned, n, YOLO idx);
+    return idx;
+}
+
+static size_t stab_resolve_complex_type(struct stab *st, ident name, struct ast_type *ty) {
+    struct stab_type t;
+    memset(&t, 0, sizeof(t));
+    t.defn = NULL;
+    t.name = name;
+    t.ty.tag = ty->tag;
+    t.magic = 0;
 
     switch (ty->tag) {
         case TYPE_POINTER:
-            t->ty.pointer = stab_resolve_type(st, strdup(name), ty->pointer);
-            t->size = ABI_POINTER_SIZE; // XHAZARD
-            t->align = ABI_POINTER_ALIGN; // XHAZARD
+            t.ty.pointer = stab_resolve_type(st, name, ty->pointer);
+            t.size = ABI_POINTER_SIZE; // XHAZARD
+            t.align = ABI_POINTER_ALIGN; // XHAZARD
             break;
 
         case TYPE_RECORD:
-            t->ty.record.fields = list_empty(CB free_stab_record_field);
+            // records are nominal: each declaration is a type of its own.
+            t.ty.record.fields = list_empty(xfree);
+            t.size = 0;
+            t.align = 1;
 
             LFOREACH(struct ast_record_field *field, ty->record)
                 // todo: check that field name is unique
-                list_add(t->ty.record.fields, YOLO stab_record_field(field->name, stab_resolve_type(st, strdup(field->name), field->type)));
+                size_t ft = stab_resolve_type(st, field->name, field->type);
+                // fields go one after the other, each padded to its alignment.
+                uint64_t align = STAB_TYPE(st, ft)->align;
+                t.size = (t.size + align - 1) & ~(align - 1);
+                list_add(t.ty.record.fields, YOLO stab_record_field(field->name, ft, t.size));
+                t.size += STAB_TYPE(st, ft)->size;
+                if (align > t.align) t.align = align;
             ENDLFOREACH;
+            // and the whole is a multiple of it, so that arrays of them would be too.
+            t.size = (t.size + t.align - 1) & ~(t.align - 1);
 
-            break;
+            struct stab_type *rec = M(struct stab_type);
+            *rec = t;
+            return ptrvec_push(st->types, YOLO rec);
 
         case TYPE_ARRAY:
-            t->ty.array.lower = atoi(ty->array.lower);
-            t->ty.array.upper = atoi(ty->array.upper);
-            t->ty.array.elt_type = stab_resolve_type(st, strdup("<array elts>"), ty->array.elt_type);
-            t->size = STAB_TYPE(st, t->ty.array.elt_type)->size * (t->ty.array.upper - t->ty.array.lower);
+            t.ty.array.lower = atoi(ident_str(ty->array.lower));
+            t.ty.array.upper = atoi(ident_str(ty->array.upper));
+            t.ty.array.elt_type = stab_resolve_type(st, intern_cstr("<array elts>"), ty->array.elt_type);
+            t.size = STAB_TYPE(st, t.ty.array.elt_type)->size * (t.ty.array.upper - t.ty.array.lower + 1);
+            t.align = STAB_TYPE(st, t.ty.array.elt_type)->align;
             break;
 
         case TYPE_FUNCTION:
-            t->ty.func.type = ty->func.type;
-            t->ty.func.retty = stab_resolve_type(st, strdup("<func ret>"), ty->func.retty);
-            t->ty.func.args = list_empty(CB dummy_free);
-            t->ty.func.ret_assigned = false;
-            t->magic = 0;
+            t.ty.func.type = ty->func.type;
+            t.ty.func.retty = stab_resolve_type(st, intern_cstr("<func ret>"), ty->func.retty);
+            // just the types: the parameters only become variables in the
+            // subprogram's own scope, when it's analyzed.
+            t.ty.func.args = list_empty(CB dummy_free);
+            t.ty.func.ret_assigned = false;
 
             LFOREACH(struct ast_decls *decl, ty->func.args)
-                LFOREACH(char *name, decl->names)
-                    size_t id = stab_resolve_type(st, strdup(name), decl->type);
-                    list_add(t->ty.func.args, YOLO stab_add_var(st, strdup(name), id, NULL, NULL, false));
-                ENDLFOREACH;
+                size_t id = stab_resolve_type(st, intern_cstr("<arg>"), decl->type);
+                for (size_t n = 0; n < decl->names->length; n++) {
+                    list_add(t.ty.func.args, YOLO id);
+                }
             ENDLFOREACH;
 
-            t->size = ABI_CLOSURE_SIZE; // XHAZARD
-            t->align = ABI_CLOSURE_ALIGN; // XHAZARD
+            t.size = ABI_CLOSURE_SIZE; // XHAZARD
+            t.align = ABI_CLOSURE_ALIGN; // XHAZARD
             break;
 
         default:
@@ -265,36 +387,28 @@ static size_t stab_resolve_complex_type(struct stab *st, char *name, struct ast_
             return -1;
     }
 
-    return ptrvec_push(st->types, YOLO t);
+    return stab_intern_type(st, &t);
 }
 
-size_t stab_resolve_type(struct stab *st, char *name, struct ast_type *ty) {
+size_t stab_resolve_type(struct stab *st, ident name, struct ast_type *ty) {
     if (ty == NULL) {
-        free(name);
         return VOID_TYPE_IDX;
     }
 
     switch (ty->tag) {
         case TYPE_REF:
-            free(name);
             return stab_resolve_type_name(st, ty->ref);
         case TYPE_INTEGER:
-            free(name);
             return INTEGER_TYPE_IDX;
         case TYPE_REAL:
-            free(name);
             return REAL_TYPE_IDX;
         case TYPE_STRING:
-            free(name);
             return STRING_TYPE_IDX;
         case TYPE_BOOLEAN:
-            free(name);
             return BOOLEAN_TYPE_IDX;
         case TYPE_CHAR:
-            free(name);
             return CHAR_TYPE_IDX;
         case TYPE_VOID:
-            free(name);
             return VOID_TYPE_IDX;
 
         case TYPE_POINTER:
@@ -312,37 +426,37 @@ size_t stab_resolve_type(struct stab *st, char *name, struct ast_type *ty) {
 void stab_add_decls(struct stab *st, struct ast_decls *decls, int *off, bool arguments) {
     // unconditionally add these to the local scope if they're not defined
     // locally. shadow upper names.
-    size_t type = stab_resolve_type(st, strdup("<decls>"), decls->type);
-    LFOREACH(char *var, decls->names)
-        if (stab_has_local_var(st, (char *)var)) {
-            span_err("%s is already defined", NULL, var);
+    size_t type = stab_resolve_type(st, intern_cstr("<decls>"), decls->type);
+    LFOREACH(void *var, decls->names)
+        if (stab_has_local_var(st, P_IDENT(var))) {
+            span_err("%s is already defined", NULL, ident_str(P_IDENT(var)));
         } else {
-            stab_add_var(st, strdup(var), type, NULL, off, arguments);
+            stab_add_var(st, P_IDENT(var), type, NULL, off, arguments);
         }
     ENDLFOREACH;
     //? stab_abort(st);
     return;
 }
 
-void stab_add_func(struct stab *st, char *name, struct ast_type *sig) {
+void stab_add_func(struct stab *st, ident name, struct ast_type *sig) {
     assert(sig->tag == TYPE_FUNCTION);
     if (stab_has_local_func(st, name)) {
-        span_err("%s is already defined", NULL, name);
+        span_err("%s is already defined", NULL, ident_str(name));
     } else {
         size_t type = stab_resolve_complex_type(st, name, sig);
-        hash_insert(((struct stab_scope *)list_last(st->chain))->funcs, YOLO name, YOLO type);
+        stab_bind(st, NS_FUNC, name, type);
     }
     //? stab_abort(st);
     return;
 }
 
 void stab_add_magic_func(struct stab *st, int which) {
-    char *name;
+    ident name;
     switch (which) {
-        case MAGIC_READLN: name = strdup("readln"); break;
-        case MAGIC_READ: name = strdup("read"); break;
-        case MAGIC_WRITELN: name = strdup("writeln"); break;
-        case MAGIC_WRITE: name = strdup("write"); break;
+        case MAGIC_READLN: name = intern_cstr("readln"); break;
+        case MAGIC_READ: name = intern_cstr("read"); break;
+        case MAGIC_WRITELN: name = intern_cstr("writeln"); break;
+        case MAGIC_WRITE: name = intern_cstr("write"); break;
         default: abort(); break;
     }
     struct stab_type *t = M(struct stab_type);
@@ -353,73 +467,45 @@ void stab_add_magic_func(struct stab *st, int which) {
     t->ty.func.args = NULL;
 
     size_t type = ptrvec_push(st->types, t);
-    hash_insert(((struct stab_scope *)list_last(st->chain))->funcs, YOLO name, YOLO type);
+    stab_bind(st, NS_FUNC, name, type);
 
     return;
 }
 
-void stab_add_type(struct stab *st, char *name, struct ast_type *ty) {
+void stab_add_type(struct stab *st, ident name, struct ast_type *ty) {
     if (stab_has_local_type(st, name)) {
-        span_err("%s is already defined", NULL, name);
+        span_err("%s is already defined", NULL, ident_str(name));
     } else {
         size_t type = stab_resolve_type(st, name, ty);
-        hash_insert(((struct stab_scope *)list_last(st->chain))->types, YOLO name, YOLO type);
+        stab_bind(st, NS_TYPE, name, type);
     }
     //? stab_abort(st);
     return;
 }
 
 
-bool stab_has_local_type(struct stab *st, char *name) {
-    size_t id = (size_t) hash_lookup(((struct stab_scope *)list_last(st->chain))->types, YOLO name);
-    return id != RESOLVE_FAILURE;
+bool stab_has_local_type(struct stab *st, ident name) {
+    return stab_has_local(st, NS_TYPE, name);
 }
 
-bool stab_has_local_var(struct stab *st, char *name) {
-    size_t id = (size_t) hash_lookup(((struct stab_scope *)list_last(st->chain))->vars, YOLO name);
-    return id != RESOLVE_FAILURE;
+bool stab_has_local_var(struct stab *st, ident name) {
+    return stab_has_local(st, NS_VAR, name);
 }
 
-bool stab_has_local_func(struct stab *st, char *name) {
-    size_t id = (size_t) hash_lookup(((struct stab_scope *)list_last(st->chain))->funcs, YOLO name);
-    return id != RESOLVE_FAILURE;
+bool stab_has_local_func(struct stab *st, ident name) {
+    return stab_has_local(st, NS_FUNC, name);
 }
 
 bool stab_types_eq(struct stab *st, size_t a, size_t b) {
-    // todo: when cache in place, just check a == b
-    struct stab_type *at = STAB_TYPE(st, a), *bt = STAB_TYPE(st, b);
-    if (at->ty.tag != bt->ty.tag) {
-        return false;
-    } else {
-        switch (at->ty.tag) {
-            case TYPE_BOOLEAN:
-            case TYPE_CHAR:
-            case TYPE_INTEGER:
-            case TYPE_REAL:
-            case TYPE_STRING:
-                return true;
-            case TYPE_ARRAY:
-                return (at->ty.array.upper == bt->ty.array.upper
-                    &&  at->ty.array.lower == bt->ty.array.lower
-                    &&  at->ty.array.elt_type == bt->ty.array.elt_type);
-            case TYPE_FUNCTION:
-            case TYPE_RECORD:
-                return a == b;
-            case TYPE_POINTER:
-                return stab_types_eq(st, at->ty.pointer, bt->ty.pointer);
-
-            case TYPE_REF:
-            default:
-                DIAG("bad type for comparison!\n");
-                abort();
-        }
-    }
+    // structural types are interned and records are nominal, so equal types
+    // are the same type.
+    return a == b;
 }
 
 void stab_print_type(struct stab *st, size_t t, int indent) {
     struct stab_type *ty = STAB_TYPE(st, t);
-    INDENT; DEBUG("<id %ld> ", t);
-    INDENT;
+    // diagnostics go to stderr, so the indentation does too.
+    DIAG("%*s", indent, "");
     switch (ty->ty.tag) {
         case TYPE_BOOLEAN:
             DIAG("boolean\n");
@@ -437,16 +523,16 @@ void stab_print_type(struct stab *st, size_t t, int indent) {
             DIAG("string\n");
             break;
         case TYPE_ARRAY:
-            DIAG("array `%s`\n", ty->name);
+            DIAG("array `%s`\n", ident_str(ty->name));
             break;
         case TYPE_FUNCTION:
-            DIAG("%s %s\n", ty->ty.func.type == SUB_PROCEDURE ? "procedure" : "function", ty->name);
+            DIAG("%s %s\n", ty->ty.func.type == SUB_PROCEDURE ? "procedure" : "function", ident_str(ty->name));
             break;
         case TYPE_RECORD:
-            DIAG("record `%s`\n", ty->name);
+            DIAG("record `%s`\n", ident_str(ty->name));
             break;
         case TYPE_POINTER:
-            DIAG("pointer to `%s`\n", ty->name);
+            DIAG("pointer to `%s`\n", ident_str(ty->name));
             break;
         case TYPE_VOID:
             DIAG("void\n");
@@ -3,7 +3,6 @@
 
 #include "util.h"
 #include "parser.tab.h"
-#include "lexer.h"
 #include "ast.h"
 
 #define RESOLVE_FAILURE (-1)
@@ -25,6 +24,14 @@
 #define ABI_CLOSURE_SIZE 16
 #define ABI_CLOSURE_ALIGN 16
 
+// the three namespaces a name can be bound in.
+enum stab_ns {
+    NS_VAR,
+    NS_FUNC,
+    NS_TYPE,
+    NUM_NS,
+};
+
 struct stab {
     struct ptrvec *vars, *types;
     // maps from "loc id" to "scope". generated by incrementing 1 for each
@@ -34,30 +41,60 @@ struct stab {
     // a stack of scopes, for use during resolution but freed immediately
     // afterwards (though each individual scope is held onto)
     struct list *chain;
+    // per namespace, maps each name to the innermost stab_binding of it. so
+    // resolution is one lookup no matter how deeply scopes are nested.
+    struct hash_table *names[NUM_NS];
+    // every binding made, in order. stab_leave pops back to the scope's mark,
+    // uncovering whatever each binding shadowed.
+    struct ptrvec *undo;
+    // the structural (pointer, array and function) types, each made once:
+    // maps a stab_type to its index in types.
+    struct hash_table *interned;
+    // how often the path caches had the answer, for the -t report.
+    size_t path_hits, path_misses;
+};
+
+struct stab_binding {
+    size_t idx; // into vars or types, depending on the namespace
+    ident name;
+    enum stab_ns ns;
+    int depth; // length of the chain when the binding was made
+    struct stab_binding *shadowed;
 };
 
-// all map from name -> table index
 struct stab_scope {
-    // variables in scope.
-    struct hash_table *vars;
-    // functions in scope. uses stab_var, but
-    struct hash_table *funcs;
-    // types in scope.
-    struct hash_table *types;
+    // indices of the variables declared in this scope, in order.
+    struct ptrvec *vars;
+    int depth;
+    // length of st->undo when the scope was entered.
+    size_t undo_mark;
     int stack_frame_length;
-    // non-owning caches. *not* complete, but populated on-demand.
-    // struct hash_table *expr_ty_cache, *path_ty_cache;
+    // what each field path used in this scope resolves to, by its interned
+    // spelling (see stab_path_ty), filled in on demand. a new binding in the
+    // scope empties it, and leaving the scope frees it.
+    struct hash_table *path_ty_cache;
+};
+
+// a path resolved in some scope: its root variable, whether that's reached
+// through the display, the offset of the field the path names, and its type.
+struct stab_path_ty {
+    size_t var;
+    bool nonlocal;
+    int offset;
+    size_t type;
 };
 
 struct insn;
 
 struct stab_var {
     size_t type;
-    char *name;
+    ident name;
     YYLTYPE *defn; // todo: annotate all AST nodes with a span...
     int disp_offset;
     int stack_base_offset;
     bool captured; // whether this variable needs to be lifted to a closure environment
+    bool addressed; // read into, so it has to stay in memory
+    int vreg; // the virtual register ir_build keeps it in, or -1
 };
 
 struct stab_resolved_type {
@@ -82,13 +119,14 @@ struct stab_resolved_type {
 };
 
 struct stab_record_field {
-    char *name;
+    ident name;
     size_t type;
+    uint64_t offset; // from the start of the record
 };
 
 struct stab_type {
     struct stab_resolved_type ty;
-    char *name;
+    ident name;
     YYLTYPE *defn; // todo
     uint64_t size, align;
     int magic;
@@ -101,19 +139,23 @@ struct stab *stab_new();
 void stab_free(struct stab *);
 
 void stab_add_decls(struct stab *, struct ast_decls *, int *, bool);
-size_t stab_add_var(struct stab *st, char *name, size_t type, YYLTYPE *span, int *, bool);
-void stab_add_func(struct stab *, char *, struct ast_type *);
+size_t stab_add_var(struct stab *st, ident name, size_t type, YYLTYPE *span, int *, bool);
+void stab_add_func(struct stab *, ident, struct ast_type *);
 void stab_add_magic_func(struct stab *, int);
-void stab_add_type(struct stab *, char *, struct ast_type *);
+void stab_add_type(struct stab *, ident, struct ast_type *);
+
+bool stab_has_local_var(struct stab *, ident);
+bool stab_has_local_func(struct stab *, ident);
+bool stab_has_local_type(struct stab *, ident);
 
-bool stab_has_local_var(struct stab *, char *);
-bool stab_has_local_func(struct stab *, char *);
-bool stab_has_local_type(struct stab *, char *);
+size_t stab_resolve_var(struct stab *, ident);
+size_t stab_resolve_func(struct stab *, ident);
+size_t stab_resolve_type(struct stab *, ident, struct ast_type *);
+size_t stab_resolve_type_name(struct stab *, ident);
 
-size_t stab_resolve_var(struct stab *, char *);
-size_t stab_resolve_func(struct stab *, char *);
-size_t stab_resolve_type(struct stab *, char *, struct ast_type *);
-size_t stab_resolve_type_name(struct stab *, char *);
+// the innermost scope's path cache. a miss is NULL.
+struct stab_path_ty *stab_cached_path_ty(struct stab *, ident path);
+void stab_cache_path_ty(struct stab *, ident path, struct stab_path_ty *);
 
 // random crap
 bool stab_types_eq(struct stab *, size_t, size_t);
@@ -125,7 +167,7 @@ void stab_print_type(struct stab *, size_t, int);
 
 #define CHKRES(type, name, idx) do {\
     if (idx == -1) {\
-        span_err("resolution failure! %s `%s` not found", NULL, type, name);\
+        span_err("resolution failure! %s `%s` not found", NULL, type, ident_str(name));\
     } } while(0)
 #define CHKREST(i, n) CHKRES("type", n, i)
 #define CHKRESV(i, n) CHKRES("variable", n, i)
@@ -1,5 +1,7 @@
 #include "util.h"
 #include <assert.h>
+#include <string.h>
+#include <time.h>
 
 // in general, the tests in this file ensure that the behavior of the data
 // structures in util.c is correct. valgrind/asan/ubsan will catch any memory
@@ -76,9 +78,221 @@ void test_ptrvec_smoke() {
     ptrvec_free(p);
 }
 
+void test_arena_smoke() {
+    struct arena a;
+    arena_init(&a);
+    current_arena = &a;
+
+    // the containers allocate from the arena, and their frees are no-ops.
+    struct list *l = list_empty(xfree);
+    struct ptrvec *p = ptrvec_wcap(0, xfree);
+    for (int i = 0; i < 4096; i++) {
+        int *e = M(int);
+        assert(*e == 0);
+        *e = i;
+        list_add(l, e);
+        ptrvec_push(p, e);
+    }
+    for (int i = 0; i < 4096; i++) {
+        assert(*(int *)p->data[i] == i);
+    }
+    // bigger than a chunk
+    char *big = xcalloc(1 << 20);
+    big[(1 << 20) - 1] = 1;
+    list_free(l);
+    ptrvec_free(p);
+
+    assert(a.allocs > 8192);
+    assert(a.chunks > 1);
+
+    current_arena = NULL;
+    arena_reset(&a);
+    assert(a.head == NULL && a.allocs == 0);
+}
+
+void test_intern_smoke() {
+    char buf[32];
+    ident ids[1024];
+    for (int i = 0; i < 1024; i++) {
+        snprintf(buf, sizeof(buf), "x%d", i);
+        ids[i] = intern_cstr(buf);
+        assert(ids[i] != NO_IDENT);
+        assert(strcmp(ident_str(ids[i]), buf) == 0);
+    }
+    // interning the same spelling again hands back the same id.
+    for (int i = 0; i < 1024; i++) {
+        snprintf(buf, sizeof(buf), "x%d", i);
+        assert(intern(buf, strlen(buf)) == ids[i]);
+    }
+    // only the first len bytes are the spelling.
+    assert(intern("x1000000", 2) == ids[1]);
+    assert(intern_count() == 1024);
+
+    intern_free();
+    assert(intern_count() == 0);
+}
+
+void test_hash_growth() {
+    // many more entries than the initial size, with keys that collide in
+    // the low bits, so probing has to walk past full groups.
+    struct hash_table *h = hash_new(0, hash_pointer, compare_pointer, dummy_free, dummy_free);
+    for (uintptr_t i = 1; i <= 10000; i++) {
+        hash_insert(h, (void *)(i << 12), (void *) i);
+    }
+    assert(h->length == 10000);
+    for (uintptr_t i = 1; i <= 10000; i++) {
+        assert((uintptr_t) hash_lookup(h, (void *)(i << 12)) == i);
+    }
+    assert(hash_lookup(h, (void *) 1) == (void *)-1);
+    // overwriting keeps the length.
+    hash_insert(h, (void *)(1 << 12), (void *) 42);
+    assert((uintptr_t) hash_lookup(h, (void *)(1 << 12)) == 42);
+    assert(h->length == 10000);
+    hash_free(h);
+}
+
+/* benchmarks, run with `test_util bench` */
+
+// the chained table that hash_table replaced, kept here for comparison.
+struct chained_table {
+    size_t num_buckets;
+    HASH_FUNC hash;
+    COMPARE_FUNC comp;
+    struct list **buckets;
+};
+
+static struct chained_table *chained_new(size_t num_buckets, HASH_FUNC hash, COMPARE_FUNC comp) {
+    struct chained_table *ret = M(struct chained_table);
+    ret->num_buckets = num_buckets;
+    ret->hash = hash;
+    ret->comp = comp;
+    ret->buckets = malloc(sizeof(struct list*) * num_buckets);
+    for (int i = 0; i < num_buckets; i++) {
+        ret->buckets[i] = list_empty(free);
+    }
+    return ret;
+}
+
+static void *chained_lookup(struct chained_table *tab, void *key) {
+    struct list *bucket = tab->buckets[tab->hash(key) % tab->num_buckets];
+    LFOREACH(struct bucket_entry *ent, bucket)
+        if (tab->comp(key, ent->key)) { return ent->val; }
+    ENDLFOREACH;
+    return (void *)-1;
+}
+
+static void chained_insert(struct chained_table *tab, void *key, void *val) {
+    struct list *bucket = tab->buckets[tab->hash(key) % tab->num_buckets];
+    LFOREACH(struct bucket_entry *ent, bucket)
+        if (tab->comp(key, ent->key)) { ent->val = val; return; }
+    ENDLFOREACH;
+    struct bucket_entry *b = M(struct bucket_entry);
+    b->key = key;
+    b->val = val;
+    list_add(bucket, b);
+}
+
+static void chained_free(struct chained_table *tab) {
+    for (int j = 0; j < tab->num_buckets; j++) {
+        list_free(tab->buckets[j]);
+    }
+    D(tab->buckets);
+    D(tab);
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH_SCOPES 20000
+#define BENCH_SCOPE_NAMES 8
+#define BENCH_KEYS 100000
+#define BENCH_LOOKUPS 10
+
+void bench_hash() {
+    double t;
+    uintptr_t sink = 0;
+
+    // what stab_enter does: three tables per scope, a handful of names each.
+    t = now();
+    for (int i = 0; i < BENCH_SCOPES; i++) {
+        struct chained_table *c[3];
+        for (int k = 0; k < 3; k++) {
+            c[k] = chained_new(1 << 8, hash_ident, compare_pointer);
+        }
+        for (uintptr_t n = 1; n <= BENCH_SCOPE_NAMES; n++) {
+            chained_insert(c[n % 3], (void *) n, (void *) n);
+        }
+        for (uintptr_t n = 1; n <= BENCH_SCOPE_NAMES; n++) {
+            sink += (uintptr_t) chained_lookup(c[n % 3], (void *) n);
+        }
+        for (int k = 0; k < 3; k++) {
+            chained_free(c[k]);
+        }
+    }
+    printf("scopes  chained: %8.1f ns/scope\n", (now() - t) * 1e9 / BENCH_SCOPES);
+
+    t = now();
+    for (int i = 0; i < BENCH_SCOPES; i++) {
+        struct hash_table *h[3];
+        for (int k = 0; k < 3; k++) {
+            h[k] = hash_new(0, hash_ident, compare_pointer, dummy_free, dummy_free);
+        }
+        for (uintptr_t n = 1; n <= BENCH_SCOPE_NAMES; n++) {
+            hash_insert(h[n % 3], (void *) n, (void *) n);
+        }
+        for (uintptr_t n = 1; n <= BENCH_SCOPE_NAMES; n++) {
+            sink += (uintptr_t) hash_lookup(h[n % 3], (void *) n);
+        }
+        for (int k = 0; k < 3; k++) {
+            hash_free(h[k]);
+        }
+    }
+    printf("scopes  open:    %8.1f ns/scope\n", (now() - t) * 1e9 / BENCH_SCOPES);
+
+    // one big table, looked up over and over.
+    struct chained_table *c = chained_new(1 << 8, hash_ident, compare_pointer);
+    struct hash_table *h = hash_new(0, hash_ident, compare_pointer, dummy_free, dummy_free);
+    for (uintptr_t n = 1; n <= BENCH_KEYS; n++) {
+        chained_insert(c, (void *) n, (void *) n);
+        hash_insert(h, (void *) n, (void *) n);
+    }
+
+    t = now();
+    for (int r = 0; r < BENCH_LOOKUPS; r++) {
+        for (uintptr_t n = 1; n <= BENCH_KEYS; n++) {
+            sink += (uintptr_t) chained_lookup(c, (void *) n);
+        }
+    }
+    printf("lookups chained: %8.1f ns/lookup\n", (now() - t) * 1e9 / (BENCH_KEYS * BENCH_LOOKUPS));
+
+    t = now();
+    for (int r = 0; r < BENCH_LOOKUPS; r++) {
+        for (uintptr_t n = 1; n <= BENCH_KEYS; n++) {
+            sink += (uintptr_t) hash_lookup(h, (void *) n);
+        }
+    }
+    printf("lookups open:    %8.1f ns/lookup\n", (now() - t) * 1e9 / (BENCH_KEYS * BENCH_LOOKUPS));
+
+    chained_free(c);
+    hash_free(h);
+    // keep the lookups from being optimized away.
+    if (sink == 0) puts("");
+}
+
 int main(int argc, char **argv) {
     test_list_empty();
     test_list_append();
     test_hash_empty();
     test_hash_smoke();
+    test_hash_growth();
+    test_ptrvec_smoke();
+    test_arena_smoke();
+    test_intern_smoke();
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench_hash();
+    }
 }
@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# Compiler throughput over a fixed set of generated programs:
+#
+#     ./bench.sh <genprog> <dragon> <workdir> [runs]
+#
+# Each config is generated once into workdir and compiled runs (default 5)
+# times with -T; every phase reports its fastest run, so one noisy run
+# doesn't move the numbers. compile is parse + analysis + ir + opt + codegen
+# + teardown, the time a plain dragon invocation spends (lexing happens inside
+# the parse), and lines/s is over that.
+
+genprog=$1
+dragon=$2
+workdir=$3
+runs=${4:-5}
+
+if [ -z "$genprog" ] || [ -z "$dragon" ] || [ -z "$workdir" ]; then
+    echo "usage: $0 <genprog> <dragon> <workdir> [runs]" >&2
+    exit 1
+fi
+mkdir -p "$workdir" || exit 1
+
+# name and genprog arguments. changing these changes the programs, so old
+# numbers are no longer comparable.
+configs=(
+    "small   -n 10"
+    "wide    -n 2000 -d 1"
+    "deep    -n 100 -d 12"
+    "locals  -n 200 -m 64"
+    "exprs   -n 200 -e 6"
+    "mixed   -n 500 -d 3 -a 40 -r 20"
+)
+
+# the fastest wall time of phase $1 across the reports in $2.
+phase_min() {
+    grep -o "\"name\":\"$1\",\"wall_ms\":[0-9.]*" "$2" | cut -d: -f3 \
+        | sort -g | head -n 1
+}
+
+# the value of counter $1 in the first report in $2.
+counter() {
+    head -n 1 "$2" | grep -o "\"$1\":[0-9]*" | head -n 1 | cut -d: -f2
+}
+
+printf "%-8s %8s %8s %7s %7s %7s %9s %9s %9s %9s %9s %9s %9s %9s %10s\n" \
+    config lines nodes idents scopes vars "lex ms" "parse ms" "anal ms" \
+    "ir ms" "opt ms" "cg ms" "tear ms" "comp ms" "lines/s"
+
+failed=0
+for config in "${configs[@]}"; do
+    read -r name args <<< "$config"
+    src="$workdir/$name.p"
+    reports="$workdir/$name.json"
+
+    $genprog $args > "$src" || exit 1
+    : > "$reports"
+    for ((i = 0; i < runs; i++)); do
+        if ! "$dragon" -T "$src" 2>> "$reports" > /dev/null; then
+            echo "$name: compile failed" >&2
+            failed=1
+            continue 2
+        fi
+    done
+
+    lines=$(wc -l < "$src")
+    lex=$(phase_min lex "$reports")
+    parse=$(phase_min parse "$reports")
+    analysis=$(phase_min analysis "$reports")
+    ir=$(phase_min ir "$reports")
+    opt=$(phase_min opt "$reports")
+    codegen=$(phase_min codegen "$reports")
+    teardown=$(phase_min teardown "$reports")
+    awk -v name="$name" -v lines="$lines" -v nodes="$(counter nodes "$reports")" \
+        -v idents="$(counter idents "$reports")" \
+        -v scopes="$(counter scopes "$reports")" \
+        -v vars="$(counter vars "$reports")" \
+        -v lex="$lex" -v parse="$parse" -v analysis="$analysis" -v ir="$ir" \
+        -v opt="$opt" -v codegen="$codegen" -v teardown="$teardown" 'BEGIN {
+            compile = parse + analysis + ir + opt + codegen + teardown
+            printf "%-8s %8d %8d %7d %7d %7d %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %10.0f\n",
+                name, lines, nodes, idents, scopes, vars, lex, parse, analysis,
+                ir, opt, codegen, teardown, compile,
+                (compile > 0 ? lines / (compile / 1000) : 0)
+        }'
+done
+
+exit $failed
@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Emit a program with $1 (default 100000) brace and paren comments
+# interleaved with code. Used to check that comment scanning stays linear:
+#
+#     ./gen_comments.sh 100000 > comments.p
+#     time ./dragon -ln comments.p > /dev/null
+
+n=${1:-100000}
+
+echo "program comments(output);"
+echo "var x: integer;"
+echo "begin"
+for ((i = 0; i < n / 2; i++)); do
+    echo "{ comment $i } x := $i; (* comment * $i *)"
+done
+echo "x := 0"
+echo "end."
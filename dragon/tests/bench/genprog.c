@@ -0,0 +1,244 @@
+/* Generates a synthetic Pascal program for benchmarking the compiler:
+ *
+ *     genprog [-n subprograms] [-d depth] [-m locals] [-e expr depth]
+ *             [-s statements] [-a array %] [-r record %] [-S seed]
+ *
+ * There are -n top-level functions, each the root of a chain of -d nested
+ * ones. Every scope declares -m locals, of which about -a percent are arrays
+ * and -r percent records, the rest integers; bodies have -s statements whose
+ * expressions are -e deep. The same arguments always give the same program.
+ *
+ * Everything it emits gets through analysis, so it only uses what the
+ * compiler handles today: records are declared but their fields aren't
+ * accessed, and there's no unary not or minus. */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int num_subprogs = 100, depth = 2, num_locals = 8, expr_depth = 3;
+static int num_stmts = 6, array_pct = 20, record_pct = 10;
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+// xorshift64*, so the output doesn't depend on the libc.
+static unsigned rnd(unsigned n) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned) ((rng_state * 0x2545f4914f6cdd1dULL) >> 32) % n;
+}
+
+enum local_kind { LOCAL_INT, LOCAL_ARRAY, LOCAL_RECORD };
+
+// what the scope being generated has in it.
+struct scope {
+    const char *func; // the function's name, for its return value
+    const char *child; // the nested function it can call, or NULL
+    const char *sibling; // an earlier top-level function, or NULL
+    enum local_kind *kinds;
+};
+
+static void indent(int n) {
+    for (int i = 0; i < n; i++) fputs("    ", stdout);
+}
+
+// an integer the scope can read: a parameter, an integer local or an array
+// element.
+static void gen_leaf(struct scope *sc) {
+    unsigned pick = rnd(10);
+    if (pick < 2) {
+        printf("%u", rnd(100) + 1);
+        return;
+    }
+    if (pick < 4) {
+        fputs(rnd(2) ? "a" : "b", stdout);
+        return;
+    }
+    int i;
+    do i = rnd(num_locals); while (sc->kinds[i] == LOCAL_RECORD);
+    if (sc->kinds[i] == LOCAL_ARRAY) {
+        printf("v%d[%u]", i, rnd(10) + 1);
+    } else {
+        printf("v%d", i);
+    }
+}
+
+static void gen_expr(struct scope *sc, int d) {
+    if (d <= 0) {
+        gen_leaf(sc);
+        return;
+    }
+    unsigned pick = rnd(16);
+    if (pick == 0 && (sc->child || sc->sibling)) {
+        const char *callee = sc->child && (!sc->sibling || rnd(2)) ? sc->child : sc->sibling;
+        printf("%s(", callee);
+        gen_expr(sc, d - 1);
+        fputs(", ", stdout);
+        gen_expr(sc, d - 1);
+        fputs(")", stdout);
+        return;
+    }
+    static const char *ops[] = { "+", "-", "*", "div", "mod" };
+    fputs("(", stdout);
+    gen_expr(sc, d - 1);
+    printf(" %s ", ops[rnd(5)]);
+    gen_expr(sc, d - 1);
+    fputs(")", stdout);
+}
+
+static void gen_cond(struct scope *sc) {
+    static const char *relops[] = { "=", "<>", "<", ">", "<=", ">=" };
+    int d = expr_depth > 1 ? expr_depth - 1 : 0;
+    fputs("(", stdout);
+    gen_expr(sc, d);
+    printf(" %s ", relops[rnd(6)]);
+    gen_expr(sc, d);
+    fputs(")", stdout);
+    if (rnd(3) == 0) {
+        fputs(rnd(2) ? " and (" : " or (", stdout);
+        gen_expr(sc, d);
+        printf(" %s ", relops[rnd(6)]);
+        gen_expr(sc, d);
+        fputs(")", stdout);
+    }
+}
+
+// somewhere to store an integer. parameters don't count: assigning to them
+// is assigning to a non-local, as far as analysis is concerned.
+static void gen_lvalue(struct scope *sc) {
+    int i;
+    do i = rnd(num_locals); while (sc->kinds[i] == LOCAL_RECORD);
+    if (sc->kinds[i] == LOCAL_ARRAY) {
+        printf("v%d[%u]", i, rnd(10) + 1);
+    } else {
+        printf("v%d", i);
+    }
+}
+
+static void gen_stmt(struct scope *sc, int ind, int nest) {
+    unsigned pick = nest < 2 ? rnd(10) : 0;
+    indent(ind);
+    if (pick < 6) {
+        gen_lvalue(sc);
+        fputs(" := ", stdout);
+        gen_expr(sc, expr_depth);
+    } else if (pick < 8) {
+        fputs("if ", stdout);
+        gen_cond(sc);
+        fputs(" then\n", stdout);
+        gen_stmt(sc, ind + 1, nest + 1);
+        fputs("\n", stdout);
+        indent(ind);
+        fputs("else\n", stdout);
+        gen_stmt(sc, ind + 1, nest + 1);
+    } else if (pick < 9) {
+        fputs("while ", stdout);
+        gen_cond(sc);
+        fputs(" do\n", stdout);
+        indent(ind);
+        fputs("begin\n", stdout);
+        gen_stmt(sc, ind + 1, nest + 1);
+        fputs(";\n", stdout);
+        indent(ind + 1);
+        fputs("v0 := v0 + 1\n", stdout);
+        indent(ind);
+        fputs("end", stdout);
+    } else {
+        fputs("for v0 := 1 to ", stdout);
+        gen_expr(sc, 1);
+        fputs(" do\n", stdout);
+        gen_stmt(sc, ind + 1, nest + 1);
+    }
+}
+
+static void gen_locals(enum local_kind *kinds, const char *rec, int ind) {
+    for (int i = 0; i < num_locals; i++) {
+        // v0 is always an integer, for loop counters.
+        unsigned pick = i == 0 ? 100 : rnd(100);
+        indent(ind);
+        if (pick < (unsigned) array_pct) {
+            kinds[i] = LOCAL_ARRAY;
+            printf("var v%d: array[1..10] of integer;\n", i);
+        } else if (pick < (unsigned) (array_pct + record_pct)) {
+            kinds[i] = LOCAL_RECORD;
+            printf("var v%d: %s;\n", i, rec);
+        } else {
+            kinds[i] = LOCAL_INT;
+            printf("var v%d: integer;\n", i);
+        }
+    }
+}
+
+// function <top>_<level>, with the rest of the chain nested inside it.
+static void gen_func(int top, int level, const char *sibling, int ind) {
+    char name[32], child[32], rec[32];
+    snprintf(name, sizeof(name), "f%d_%d", top, level);
+    snprintf(child, sizeof(child), "f%d_%d", top, level + 1);
+    snprintf(rec, sizeof(rec), "r%d_%d", top, level);
+    bool has_child = level + 1 < depth;
+
+    indent(ind);
+    printf("function %s(a, b: integer): integer;\n", name);
+    if (has_child) {
+        gen_func(top, level + 1, NULL, ind + 1);
+    }
+
+    indent(ind + 1);
+    printf("type %s = record x: integer; y: integer; end;\n", rec);
+    enum local_kind kinds[num_locals];
+    struct scope sc = { name, has_child ? child : NULL, sibling, kinds };
+    gen_locals(kinds, rec, ind + 1);
+
+    indent(ind);
+    fputs("begin\n", stdout);
+    for (int i = 0; i < num_stmts; i++) {
+        gen_stmt(&sc, ind + 1, 0);
+        fputs(";\n", stdout);
+    }
+    indent(ind + 1);
+    printf("%s := ", name);
+    gen_expr(&sc, expr_depth);
+    fputs("\n", stdout);
+    indent(ind);
+    fputs("end;\n", stdout);
+}
+
+int main(int argc, char **argv) {
+    int c;
+    while ((c = getopt(argc, argv, "n:d:m:e:s:a:r:S:")) != -1) {
+        switch (c) {
+            case 'n': num_subprogs = atoi(optarg); break;
+            case 'd': depth = atoi(optarg); break;
+            case 'm': num_locals = atoi(optarg); break;
+            case 'e': expr_depth = atoi(optarg); break;
+            case 's': num_stmts = atoi(optarg); break;
+            case 'a': array_pct = atoi(optarg); break;
+            case 'r': record_pct = atoi(optarg); break;
+            case 'S': rng_state = strtoull(optarg, NULL, 0) * 0x9e3779b97f4a7c15ULL | 1; break;
+            default:
+                fprintf(stderr, "usage: genprog [-n subprograms] [-d depth] [-m locals] "
+                        "[-e expr depth] [-s statements] [-a array %%] [-r record %%] [-S seed]\n");
+                return 1;
+        }
+    }
+    if (depth < 1) depth = 1;
+    if (num_locals < 1) num_locals = 1;
+
+    puts("program bench(input, output);");
+    puts("var a, b: integer;");
+    char sibling[32];
+    for (int i = 0; i < num_subprogs; i++) {
+        snprintf(sibling, sizeof(sibling), "f%d_0", i - 1);
+        gen_func(i, 0, i > 0 ? sibling : NULL, 0);
+    }
+    puts("begin");
+    puts("    a := 1;");
+    puts("    b := 2;");
+    for (int i = 0; i < num_subprogs; i++) {
+        printf("    a := f%d_0(a, b);\n", i);
+    }
+    puts("    write(a)");
+    puts("end.");
+    return 0;
+}
@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# Quality of the generated code, over the run-pass programs:
+#
+#     ./runbench.sh <srcdir> <dragon> <perfrun> <workdir> [runs]
+#
+# Each program is compiled, assembled with $ASM (default yasm) against rt.s,
+# linked with $CC (default cc), and run once to check its output. Then it's
+# run runs (default 5) more times under perfrun, keeping the fewest cycles,
+# instructions and tsc ticks seen. text is the size of the program's own code,
+# not counting rt.s or libc. A program that doesn't build or prints the wrong
+# thing gets a row saying so instead of numbers.
+
+srcdir=$1
+dragon=$2
+perfrun=$3
+workdir=$4
+runs=${5:-5}
+asm=${ASM:-yasm}
+cc=${CC:-cc}
+
+if [ -z "$srcdir" ] || [ -z "$dragon" ] || [ -z "$perfrun" ] || [ -z "$workdir" ]; then
+    echo "usage: $0 <srcdir> <dragon> <perfrun> <workdir> [runs]" >&2
+    exit 1
+fi
+mkdir -p "$workdir" || exit 1
+$asm -f elf64 -o "$workdir/rt.o" "$srcdir/rt.s" || exit 1
+
+# the smallest value of counter $1 in the perfrun lines in $2, or - if there
+# were none.
+best() {
+    grep -o "$1=[0-9]*" "$2" | cut -d= -f2 | sort -n | head -n 1 | grep . || echo -
+}
+
+printf "%-10s %8s %15s %15s %15s\n" program text cycles instructions tsc
+
+failed=0
+for file in "$srcdir"/tests/run-pass/*.p; do
+    name=$(basename "$file" .p)
+    out="$workdir/$name"
+
+    if ! "$dragon" "$file" > "$out.s" ||
+        ! $asm -f elf64 -o "$out.o" "$out.s" ||
+        ! $cc -no-pie -o "$out" "$out.o" "$workdir/rt.o"; then
+        printf "%-10s %s\n" "$name" "doesn't build"
+        failed=1
+        continue
+    fi
+    if ! "$out" > "$out.actual" 2>&1 || ! cmp -s "$out.actual" "$file.expected"; then
+        printf "%-10s %s\n" "$name" "wrong output"
+        failed=1
+        continue
+    fi
+
+    : > "$out.perf"
+    for ((i = 0; i < runs; i++)); do
+        "$perfrun" "$out" 2>> "$out.perf" > /dev/null
+    done
+    text=$(size -A "$out.o" | awk '$1 == ".text" { print $2 }')
+    printf "%-10s %8d %15s %15s %15s\n" "$name" "$text" "$(best cycles "$out.perf")" \
+        "$(best instructions "$out.perf")" "$(best tsc "$out.perf")"
+done
+
+exit $failed
@@ -0,0 +1,12 @@
+(* ERROR: function called with too many arguments *)
+program arg_count(output);
+var a: integer;
+
+function double(n: integer): integer;
+begin
+    double := n + n
+end;
+
+begin
+    a := double(1, 2)
+end.
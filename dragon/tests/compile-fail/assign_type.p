@@ -0,0 +1,6 @@
+(* ERROR: assigning a boolean to an integer *)
+program assign_type(output);
+var a: integer;
+begin
+    a := 1 < 2
+end.
@@ -0,0 +1,6 @@
+(* ERROR: a comment still open at the end of the input *)
+program comment(output);
+begin
+    writeln(1)
+end.
+(* never closed
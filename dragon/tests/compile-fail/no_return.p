@@ -0,0 +1,13 @@
+(* ERROR: function never assigns its return value *)
+program no_return(output);
+var a: integer;
+
+function f(n: integer): integer;
+var m: integer;
+begin
+    m := n
+end;
+
+begin
+    a := f(1)
+end.
@@ -0,0 +1,13 @@
+(* ERROR: function assigns to a global *)
+program nonlocal(output);
+var a: integer;
+
+function f(n: integer): integer;
+begin
+    a := n;
+    f := n
+end;
+
+begin
+    a := f(1)
+end.
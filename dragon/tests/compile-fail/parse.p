@@ -0,0 +1,7 @@
+(* ERROR: missing semicolon between statements *)
+program parse(output);
+var a: integer;
+begin
+    a := 1
+    a := 2
+end.
@@ -0,0 +1,7 @@
+(* ERROR: variable declared twice in one scope *)
+program redefined(output);
+var a: integer;
+var a: integer;
+begin
+    a := 1
+end.
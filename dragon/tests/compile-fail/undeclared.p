@@ -0,0 +1,6 @@
+(* ERROR: use of an undeclared variable *)
+program undeclared(output);
+var a: integer;
+begin
+    a := b + 1
+end.
@@ -0,0 +1,50 @@
+(* Array elements at all kinds of lower bound, element size and scope: indexing is
+   one addressing mode, with the lower bound folded into the offset. *)
+program arrays(output);
+var neg: array[10..19] of integer;
+var high: array[1000000000..1000000004] of integer;
+var seen: array[0..25] of boolean;
+var flags: array[5..12] of boolean;
+var vals: array[3..9] of integer;
+var i, s: integer;
+
+procedure touch(k: integer);
+begin
+    neg[k] := neg[k] + k;
+    vals[3 + k mod 4] := vals[3 + k mod 4] + 1
+end;
+
+begin
+    for i := 10 to 19 do
+        neg[i] := i * i;
+    for i := 1000000000 to 1000000004 do
+        high[i] := i - 1000000000;
+    for i := 0 to 25 do
+        seen[i] := i < 0;
+    seen[3] := i > 0;
+    for i := 5 to 12 do
+        flags[i] := i mod 3 = 0;
+    for i := 3 to 9 do
+        vals[i] := 10 * i;
+    for i := 10 to 19 do
+        touch(i);
+    s := 0;
+    for i := 10 to 19 do
+        s := s * 3 + neg[i];
+    writeln(s);
+    writeln(neg[10] + neg[19]);
+    writeln(high[1000000000] + high[1000000004] * 100);
+    s := 0;
+    for i := 0 to 25 do
+        if seen[i] then s := s + i;
+    writeln(s);
+    s := 0;
+    for i := 5 to 12 do
+        if flags[i] then s := s * 10 + i;
+    writeln(s);
+    s := 0;
+    for i := 3 to 9 do
+        s := s * 7 + vals[i];
+    writeln(s);
+    if flags[6] and not flags[5] then writeln(1)
+end.
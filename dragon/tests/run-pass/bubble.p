@@ -0,0 +1,39 @@
+(* Bubble sort of 600 pseudo-random integers. *)
+program bubble(output);
+var a: array[1..600] of integer;
+var i, seed, sum: integer;
+
+procedure fill;
+var k: integer;
+begin
+    for k := 1 to 600 do
+    begin
+        seed := (seed * 1103515245 + 12345) mod 2147483648;
+        a[k] := seed mod 100000
+    end
+end;
+
+procedure sort;
+var k, m, t: integer;
+begin
+    for k := 1 to 599 do
+        for m := 1 to 600 - k do
+            if a[m] > a[m + 1] then
+            begin
+                t := a[m];
+                a[m] := a[m + 1];
+                a[m + 1] := t
+            end
+end;
+
+begin
+    seed := 42;
+    fill;
+    sort;
+    sum := 0;
+    for i := 1 to 600 do
+        sum := (sum + a[i] * i) mod 1000000007;
+    writeln(a[1]);
+    writeln(a[600]);
+    writeln(sum)
+end.
@@ -0,0 +1,22 @@
+(* Conditions of if and while branch as they go: and and or don't evaluate
+   their right operand once the left decides them, so it can guard a division
+   by zero. *)
+program cond(output);
+var i, j, hits: integer;
+
+begin
+    hits := 0;
+    for i := 0 to 9 do
+        for j := 0 to 9 do
+        begin
+            if (j <> 0) and (100 div j > 9) then hits := hits + 1;
+            if (j = 0) or (i div j = 1) then hits := hits + 100;
+            if not ((i = j) or (i + j = 9)) and not (i > j) then hits := hits + 10000;
+            if (0 < i) and not (j >= 3) or (i = 9) and (j = 9) then hits := hits + 1000000
+        end;
+    writeln(hits);
+    i := 5;
+    while (i <> 0) and (60 div i > 0) or (i > 3) do
+        i := i - 1;
+    writeln(i)
+end.
@@ -0,0 +1,16 @@
+(* Deep right-leaning expressions, with calls and indexing inside. *)
+program su(output);
+var x, y, a: integer;
+var c: array[1..10] of integer;
+function foo(p, q, r: integer): integer;
+begin
+    foo := p + q * r
+end;
+begin
+    x := 1; y := 2; a := 3;
+    c[1] := 4; c[2] := 5; c[3] := 6; c[4] := 7;
+    y := x + (a * (y + (x * (a + (y * (x + c[(y + foo(c[1], c[2], a)) mod 10 + 1] * 1))))));
+    writeln(y);
+    y := foo(x + c[y mod 10 + 1], 2 * (x + (y * (a + (x * (y + a))))), c[x + c[2] - 4]);
+    writeln(y)
+end.
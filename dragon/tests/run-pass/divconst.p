@@ -0,0 +1,32 @@
+(* Division, remainder and multiplication by constants, which are lowered to
+   shifts, lea and multiplies by reciprocals: every sign, rounding towards
+   zero. *)
+program divconst(output);
+var i, x, h: integer;
+
+procedure mix(v: integer);
+begin
+    h := (h * 31 + v) mod 1000000007
+end;
+
+begin
+    h := 0;
+    for i := -300 to 300 do
+    begin
+        x := i * 7919 + i * i;
+        mix(x div 2); mix(x mod 2); mix(x div 8); mix(x mod 8);
+        mix(x div (-4)); mix(x mod (-4)); mix(x div 1024); mix(x mod 1024);
+        mix(x div 3); mix(x mod 3); mix(x div 7); mix(x mod 7);
+        mix(x div 10); mix(x mod 10); mix(x div (-7)); mix(x mod (-7));
+        mix(x div 641); mix(x mod 641); mix(x div 1000003); mix(x mod 1000003);
+        mix(x * 3); mix(x * 5); mix(x * 9); mix(x * 2); mix(x * 40); mix(x * 72);
+        mix(x * 11); mix(x * (-6))
+    end;
+    writeln(h);
+    x := 9223372036854775807;
+    writeln(x div 3);
+    writeln(x mod 1000);
+    writeln((-x - 1) div 16);
+    writeln((-x - 1) mod 10);
+    writeln((-x - 1) div 7)
+end.
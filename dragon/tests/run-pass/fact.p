@@ -0,0 +1,20 @@
+(* Recursive factorial, up to the largest that fits in 64 bits. *)
+program fact(output);
+var i, n, sum: integer;
+
+function fact(n: integer): integer;
+begin
+    if n <= 1 then
+        fact := 1
+    else
+        fact := n * fact(n - 1)
+end;
+
+begin
+    for i := 1 to 20 do
+        writeln(fact(i));
+    sum := 0;
+    for n := 1 to 20000 do
+        sum := (sum + fact(20) mod 1000003 + n) mod 1000003;
+    writeln(sum)
+end.
@@ -0,0 +1,28 @@
+(* Constant subtrees, identities, and branches on constants. *)
+program fold(output);
+var x: integer;
+var b: boolean;
+
+function side(n: integer): integer;
+begin
+    writeln(n);
+    side := n
+end;
+
+begin
+    x := 6;
+    writeln(2 * 3 + 4 * (10 - 7));
+    writeln(x * 1 + 0);
+    writeln(0 + x * (5 - 4) - 0);
+    writeln((7 - 7) * x);
+    writeln(x div 1 + x mod 1);
+    writeln(-(3 - 10) div 2);
+    writeln((-7) mod 3);
+    writeln(0 * side(5));
+    b := (1 < 2) and (x > 0);
+    if b then writeln(1) else writeln(0);
+    if 3 > 4 then writeln(100) else writeln(200);
+    if (1 = 1) or (x > 100) then writeln(300);
+    while 1 > 2 do writeln(400);
+    if x - x = 0 then writeln(500) else writeln(600)
+end.
@@ -0,0 +1,42 @@
+(* for loops: ranges that run no times or once, a bound the body changes
+   (evaluated once all the same), a control variable a nested function reads,
+   and the variable's value afterwards. *)
+program forloop(output);
+var i, n, lo, hi, sum: integer;
+
+function total(m: integer): integer;
+    function seen(z: integer): integer;
+    begin
+        seen := k * m + z
+    end;
+var k, s: integer;
+begin
+    s := 0;
+    for k := 1 to m do
+        s := s + seen(0);
+    total := s
+end;
+
+begin
+    sum := 0;
+    lo := 5;
+    hi := 4;
+    for i := lo to hi do
+        sum := sum + 1;
+    writeln(sum);
+    for i := lo to lo do
+        sum := sum + i;
+    writeln(sum);
+    n := 10;
+    for i := 1 to n do
+    begin
+        n := n - 1;
+        sum := sum + n
+    end;
+    writeln(sum);
+    writeln(i);
+    for i := -3 to 3 do
+        sum := sum * 2 + i;
+    writeln(sum);
+    writeln(total(10) + total(0))
+end.
@@ -0,0 +1,34 @@
+(* Euclid's algorithm, by remainders, over every pair in 1..300. *)
+program gcd(output);
+var i, j, sum: integer;
+
+function gcd(a, b: integer): integer;
+var x, y, t: integer;
+begin
+    x := a;
+    y := b;
+    while y <> 0 do
+    begin
+        t := x mod y;
+        x := y;
+        y := t
+    end;
+    gcd := x
+end;
+
+begin
+    writeln(gcd(1071, 462));
+    sum := 0;
+    i := 1;
+    while i <= 300 do
+    begin
+        j := 1;
+        while j <= 300 do
+        begin
+            sum := sum + gcd(i, j);
+            j := j + 1
+        end;
+        i := i + 1
+    end;
+    writeln(sum)
+end.
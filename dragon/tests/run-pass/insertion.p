@@ -0,0 +1,43 @@
+(* Insertion sort of 2000 pseudo-random integers. *)
+program insertion(output);
+var a: array[1..2000] of integer;
+var i, seed, sum: integer;
+
+procedure sort;
+var k, m, v: integer;
+var moving: integer;
+begin
+    for k := 2 to 2000 do
+    begin
+        v := a[k];
+        m := k - 1;
+        moving := 1;
+        while moving = 1 do
+            if m < 1 then
+                moving := 0
+            else if a[m] <= v then
+                moving := 0
+            else
+            begin
+                a[m + 1] := a[m];
+                m := m - 1
+            end;
+        a[m + 1] := v
+    end
+end;
+
+begin
+    seed := 7;
+    for i := 1 to 2000 do
+    begin
+        seed := (seed * 1103515245 + 12345) mod 2147483648;
+        a[i] := seed mod 100000
+    end;
+    sort;
+    sum := 0;
+    for i := 1 to 2000 do
+        sum := (sum + a[i] * i) mod 1000000007;
+    writeln(a[1]);
+    writeln(a[2000]);
+    writeln(sum)
+end.
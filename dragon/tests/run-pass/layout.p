@@ -0,0 +1,31 @@
+(* Records mixing byte and word fields, nested: each field is padded to its
+   alignment, and a record to a multiple of its own. *)
+program layout(output);
+type cell = record
+    live: boolean;
+    n: integer;
+    dead: boolean;
+end;
+type board = record
+    a: cell;
+    flag: boolean;
+    b: cell;
+end;
+var x: board;
+var y: integer;
+begin
+    x.a.live := 1 < 2;
+    x.a.n := 5;
+    x.a.dead := 2 < 1;
+    x.flag := 1 < 2;
+    x.b.live := 2 < 1;
+    x.b.n := 7;
+    x.b.dead := 1 < 2;
+    y := 0;
+    if x.a.live then y := y + 1;
+    if x.a.dead then y := y + 10;
+    if x.flag then y := y + 100;
+    if x.b.live then y := y + 1000;
+    if x.b.dead then y := y + 10000;
+    writeln(y + x.a.n * 100000 + x.b.n * 1000000)
+end.
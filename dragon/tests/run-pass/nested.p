@@ -0,0 +1,27 @@
+(* Triply nested loops, and a nested function reading its parent's locals. *)
+program nested(output);
+var i, j, k, sum: integer;
+
+function weighted(n: integer): integer;
+    function term(m: integer): integer;
+    begin
+        term := m * scale + n
+    end;
+var scale: integer;
+begin
+    scale := 3;
+    weighted := term(n) mod 97
+end;
+
+begin
+    sum := 0;
+    for i := 1 to 60 do
+        for j := 1 to 60 do
+            for k := 1 to 60 do
+                sum := (sum + i * j + k) mod 1000003;
+    writeln(sum);
+    sum := 0;
+    for i := 1 to 100000 do
+        sum := sum + weighted(i);
+    writeln(sum)
+end.
@@ -0,0 +1,15 @@
+(* Values kept in registers across bare writelns, which change fewer of them
+   than other calls do. *)
+program newlines(output);
+var i, a, b, c, d, e, f, g: integer;
+
+begin
+    a := 1; b := 2; c := 3; d := 4; e := 5; f := 6; g := 7;
+    for i := 1 to 3 do
+    begin
+        writeln;
+        a := a + b; b := b + c; c := c + d; d := d + e;
+        e := e + f; f := f + g; g := g + i
+    end;
+    writeln(a + b + c + d + e + f + g)
+end.
@@ -0,0 +1,62 @@
+(* Two bodies bouncing around a box, all state in records. *)
+program records(output);
+type vec = record
+    x: integer;
+    y: integer;
+end;
+type body = record
+    pos: vec;
+    vel: vec;
+    bounces: integer;
+end;
+var a, b: body;
+var step: integer;
+
+procedure move(var_unused: integer);
+begin
+    a.pos.x := a.pos.x + a.vel.x;
+    a.pos.y := a.pos.y + a.vel.y;
+    if (a.pos.x < 0) or (a.pos.x > 1000) then
+    begin
+        a.vel.x := 0 - a.vel.x;
+        a.bounces := a.bounces + 1
+    end;
+    if (a.pos.y < 0) or (a.pos.y > 1000) then
+    begin
+        a.vel.y := 0 - a.vel.y;
+        a.bounces := a.bounces + 1
+    end;
+    b.pos.x := b.pos.x + b.vel.x;
+    b.pos.y := b.pos.y + b.vel.y;
+    if (b.pos.x < 0) or (b.pos.x > 1000) then
+    begin
+        b.vel.x := 0 - b.vel.x;
+        b.bounces := b.bounces + 1
+    end;
+    if (b.pos.y < 0) or (b.pos.y > 1000) then
+    begin
+        b.vel.y := 0 - b.vel.y;
+        b.bounces := b.bounces + 1
+    end
+end;
+
+begin
+    a.pos.x := 10;
+    a.pos.y := 20;
+    a.vel.x := 7;
+    a.vel.y := 13;
+    a.bounces := 0;
+    b.pos.x := 500;
+    b.pos.y := 900;
+    b.vel.x := 0 - 11;
+    b.vel.y := 3;
+    b.bounces := 0;
+    for step := 1 to 100000 do
+        move(step);
+    writeln(a.pos.x);
+    writeln(a.pos.y);
+    writeln(a.bounces);
+    writeln(b.pos.x);
+    writeln(b.pos.y);
+    writeln(b.bounces)
+end.
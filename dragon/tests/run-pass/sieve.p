@@ -0,0 +1,25 @@
+(* Sieve of Eratosthenes below 10000, run 20 times. *)
+program sieve(output);
+var flags: array[2..10000] of integer;
+var i, j, count, round: integer;
+
+begin
+    for round := 1 to 20 do
+    begin
+        for i := 2 to 10000 do
+            flags[i] := 1;
+        count := 0;
+        for i := 2 to 10000 do
+            if flags[i] = 1 then
+            begin
+                count := count + 1;
+                j := i + i;
+                while j <= 10000 do
+                begin
+                    flags[j] := 0;
+                    j := j + i
+                end
+            end
+    end;
+    writeln(count)
+end.
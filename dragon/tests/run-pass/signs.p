@@ -0,0 +1,20 @@
+(* Unary minus and not, division rounding toward zero, and subtracting the
+   most negative 32-bit constant. *)
+program signs(output);
+var a, b: integer;
+var flag: boolean;
+
+begin
+    a := -7;
+    b := -(a * 3);
+    writeln(a);
+    writeln(b);
+    writeln(a div 2);
+    writeln(a mod 3);
+    writeln(-a + (-b));
+    flag := not (a > b);
+    if flag then writeln(1) else writeln(0);
+    if not flag then writeln(1) else writeln(0);
+    b := a - (0 - 2147483647 - 1);
+    writeln(b)
+end.
@@ -0,0 +1,28 @@
+(* More live values than registers, across calls and round a loop. *)
+program spill(output);
+var a, b, c, d, e, f, g, h, i, j, k, l, m, n, s: integer;
+var t: boolean;
+function mix(p, q, r: integer; u: boolean): integer;
+var w: integer;
+begin
+    w := p * 3 + q;
+    if u then w := w - r;
+    mix := w
+end;
+begin
+    a := 1; b := 2; c := 3; d := 4; e := 5; f := 6; g := 7;
+    h := 8; i := 9; j := 10; k := 11; l := 12; m := 13; n := 14;
+    s := 0;
+    t := a > b;
+    while a < 50 do
+    begin
+        s := s + mix(a, b, c, t) + d * e - f + g * h - i + j * k - l + m * n;
+        a := a + 1; b := b + a; c := c + b mod 7; d := d + c mod 5;
+        e := e + 1; f := f + e; g := g + f mod 3; h := h + g mod 11;
+        i := i + 2; j := j + i mod 13; k := k + j mod 17; l := l + 1;
+        m := m + l mod 19; n := n + m mod 23;
+        t := not t
+    end;
+    writeln(s);
+    writeln(a + b + c + d + e + f + g + h + i + j + k + l + m + n)
+end.
@@ -7,6 +7,9 @@ void print_token(int tok, YYSTYPE *val) {
         case 0:
             puts("EOF");
             break;
+        case YYUNDEF:
+            puts("INVALID");
+            break;
         case DIV:
             puts("DIV");
             break;
@@ -125,10 +128,10 @@ void print_token(int tok, YYSTYPE *val) {
             puts("SEMI");
             break;
         case ID:
-            printf("ID(%s)\n", val->name);
+            printf("ID(%s)\n", ident_str(val->name));
             break;
         case NUM:
-            printf("NUM(%s)\n", val->name);
+            printf("NUM(%s)\n", ident_str(val->name));
             break;
         case DO:
             puts("DO");
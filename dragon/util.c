@@ -2,14 +2,116 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "util.h"
 #include "ast.h"
 
+/* the arena */
+
+#define ARENA_CHUNK_SIZE (1 << 16)
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t used, capacity;
+    // pads the header to 32 bytes, so data[] is as aligned as malloc's result.
+    size_t pad;
+    char data[];
+};
+
+__thread struct arena *current_arena = NULL;
+
+void arena_init(struct arena *a) {
+    a->head = NULL;
+    a->allocs = a->bytes = a->chunks = 0;
+}
+
+void *arena_alloc(struct arena *a, size_t size) {
+    size = ARENA_ROUND(size);
+    struct arena_chunk *c = a->head;
+    if (!c || c->capacity - c->used < size) {
+        size_t cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        c = malloc(sizeof(struct arena_chunk) + cap);
+        if (!c) abort();
+        c->used = 0;
+        c->capacity = cap;
+        // an oversized chunk goes behind the current one, so the space left
+        // in the current one isn't thrown away.
+        if (a->head && cap > ARENA_CHUNK_SIZE) {
+            c->next = a->head->next;
+            a->head->next = c;
+        } else {
+            c->next = a->head;
+            a->head = c;
+        }
+        a->chunks++;
+    }
+    void *p = c->data + c->used;
+    c->used += size;
+    a->allocs++;
+    a->bytes += size;
+    return memset(p, 0, size);
+}
+
+void *arena_realloc(struct arena *a, void *p, size_t old_size, size_t new_size) {
+    if (new_size <= old_size) return p;
+    old_size = ARENA_ROUND(old_size);
+    struct arena_chunk *c = a->head;
+    // the most recent allocation can grow in place.
+    if (p && c && (char *)p + old_size == c->data + c->used
+            && c->capacity - (c->used - old_size) >= ARENA_ROUND(new_size)) {
+        size_t grown = ARENA_ROUND(new_size) - old_size;
+        memset(c->data + c->used, 0, grown);
+        c->used += grown;
+        a->bytes += grown;
+        return p;
+    }
+    void *n = arena_alloc(a, new_size);
+    if (p) memcpy(n, p, old_size);
+    return n;
+}
+
+void arena_reset(struct arena *a) {
+    struct arena_chunk *c = a->head;
+    while (c) {
+        struct arena_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    arena_init(a);
+}
+
+void *xcalloc(size_t size) {
+    if (current_arena) return arena_alloc(current_arena, size);
+    void *p = calloc(1, size);
+    if (!p && size) abort();
+    return p;
+}
+
+void *xrealloc(void *p, size_t old_size, size_t new_size) {
+    if (current_arena) return arena_realloc(current_arena, p, old_size, new_size);
+    p = realloc(p, new_size);
+    if (!p && new_size) abort();
+    return p;
+}
+
+void xfree(void *p) {
+    if (!current_arena) free(p);
+}
+
 uint64_t hash_pointer(void *p) {
     return hashpjw((void*)&p, sizeof(p));
 }
 
+uint64_t hash_ident(void *p) {
+    // ids are dense, so a multiplicative hash spreads them well enough.
+    return (uint64_t)P_IDENT(p) * 0x9e3779b97f4a7c15;
+}
+
 bool compare_pointer(void *a, void *b) {
     return a == b;
 }
@@ -43,13 +145,12 @@ void list_append(struct node *a, struct node *b) {
 }
 
 static void node_free(struct node *a, void(*dtor)(void*)) {
-    if (!a) return;
-    struct node *p = a->next;
-    if (a->elt) dtor(a->elt);
-    D(a);
-    if (p) {
-        assert(p->prev == a);
-        node_free(p, dtor);
+    while (a) {
+        struct node *p = a->next;
+        if (a->elt) dtor(a->elt);
+        D(a);
+        assert(!p || p->prev == a);
+        a = p;
     }
 }
 
@@ -106,10 +207,8 @@ struct ptrvec *ptrvec_new(FREE_FUNC dtor, size_t count, ...) {
 }
 
 struct ptrvec *ptrvec_wcap(size_t cap, FREE_FUNC dtor) {
-    struct ptrvec *temp = calloc(1, sizeof(struct ptrvec));
-    if (!temp) abort();
-    void *data = calloc(cap, sizeof(void *));
-    if (!data) abort();
+    struct ptrvec *temp = M(struct ptrvec);
+    void *data = xcalloc(cap * sizeof(void *));
     temp->length = 0;
     temp->capacity = cap;
     temp->data = data;
@@ -122,9 +221,9 @@ static void ptrvec_reserve(struct ptrvec *vec, size_t len) {
     if (len < vec->capacity) {
         return;
     } else {
-        vec->capacity *= 2;
-        vec->data = realloc(vec->data, vec->capacity * sizeof(void *));
-        if (!vec->data) abort();
+        size_t old = vec->capacity;
+        vec->capacity = old ? old * 2 : 4;
+        vec->data = xrealloc(vec->data, old * sizeof(void *), vec->capacity * sizeof(void *));
     }
 }
 
@@ -136,8 +235,7 @@ size_t ptrvec_push(struct ptrvec *vec, void *elem) {
 }
 
 void *ptrvec_pop(struct ptrvec *vec) {
-    size_t idx = vec->length--;
-    return vec->data[idx];
+    return vec->data[--vec->length];
 }
 
 void *ptrvec_last(struct ptrvec *vec) {
@@ -153,62 +251,133 @@ void ptrvec_free(struct ptrvec *vec) {
     D(vec);
 }
 
-struct hash_table *hash_new(size_t num_buckets, HASH_FUNC hash,
+struct hash_table *hash_new(size_t expected, HASH_FUNC hash,
         COMPARE_FUNC comp, FREE_FUNC key_dtor, FREE_FUNC val_dtor) {
     struct hash_table *ret = M(struct hash_table);
-    ret->num_buckets = num_buckets;
+    ret->num_buckets = 0;
+    ret->length = 0;
+    ret->initial_buckets = HASH_GROUP_SIZE;
+    // room for `expected` entries under the 7/8 load factor.
+    while (ret->initial_buckets / 8 * 7 < expected) {
+        ret->initial_buckets *= 2;
+    }
     ret->hash = hash;
     ret->comp = comp;
     ret->key_dtor = key_dtor;
     ret->val_dtor = val_dtor;
-    ret->buckets = malloc(sizeof(struct list*) * num_buckets);
-    for (int i = 0; i < num_buckets; i++) {
-        ret->buckets[i] = list_empty(free);
-    }
+    ret->ctrl = NULL;
+    ret->buckets = NULL;
     return ret;
 }
 
-#define HASH tab->hash(key) % tab->num_buckets
+static uint64_t hash_mix(struct hash_table *tab, void *key) {
+    // the user's hash may have weak high bits (hashpjw does, for short keys),
+    // and those are exactly the bits that end up in the control bytes.
+    uint64_t h = tab->hash(key);
+    h ^= h >> 29;
+    return h * 0xbf58476d1ce4e5b9;
+}
+
+#define H1(h) ((size_t)(h))
+#define H2(h) ((uint8_t)((h) >> 57))
+
+// bitmask of the bytes in the group at ctrl that are equal to b.
+static inline uint32_t group_match(uint8_t *ctrl, uint8_t b) {
+#ifdef __SSE2__
+    __m128i g = _mm_loadu_si128((__m128i *) ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char) b)));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < HASH_GROUP_SIZE; i++) {
+        m |= (uint32_t)(ctrl[i] == b) << i;
+    }
+    return m;
+#endif
+}
+
+// slot of key, or the empty slot where it would go.
+static size_t hash_find(struct hash_table *tab, void *key, uint64_t h, bool *found) {
+    size_t mask = tab->num_buckets - 1;
+    size_t pos = H1(h) & mask & ~(size_t)(HASH_GROUP_SIZE - 1);
+    // triangular probing over whole groups visits every group once, since
+    // the number of groups is a power of two.
+    for (size_t stride = HASH_GROUP_SIZE; ; stride += HASH_GROUP_SIZE) {
+        uint8_t *g = tab->ctrl + pos;
+        for (uint32_t m = group_match(g, H2(h)); m; m &= m - 1) {
+            size_t i = pos + __builtin_ctz(m);
+            if (tab->comp(key, tab->buckets[i].key)) {
+                *found = true;
+                return i;
+            }
+        }
+        uint32_t empty = group_match(g, HASH_CTRL_EMPTY);
+        if (empty) {
+            *found = false;
+            return pos + __builtin_ctz(empty);
+        }
+        pos = (pos + stride) & mask;
+    }
+}
+
+static void hash_resize(struct hash_table *tab, size_t num_buckets) {
+    uint8_t *old_ctrl = tab->ctrl;
+    struct bucket_entry *old_buckets = tab->buckets;
+    size_t old_num = tab->num_buckets;
+
+    tab->num_buckets = num_buckets;
+    tab->ctrl = xcalloc(num_buckets);
+    memset(tab->ctrl, HASH_CTRL_EMPTY, num_buckets);
+    tab->buckets = xcalloc(num_buckets * sizeof(struct bucket_entry));
+
+    for (size_t i = 0; i < old_num; i++) {
+        if (old_ctrl[i] & HASH_CTRL_EMPTY) continue;
+        uint64_t h = hash_mix(tab, old_buckets[i].key);
+        bool found;
+        size_t j = hash_find(tab, old_buckets[i].key, h, &found);
+        tab->ctrl[j] = H2(h);
+        tab->buckets[j] = old_buckets[i];
+    }
+    D(old_ctrl);
+    D(old_buckets);
+}
 
 void *hash_lookup(struct hash_table *tab, void *key) {
-    struct list *bucket = tab->buckets[HASH];
-    LFOREACH(struct bucket_entry *ent, bucket)
-        if (tab->comp(key, ent->key)) { return ent->val; }
-    ENDLFOREACH;
+    if (tab->length == 0) {
+        return (void *)-1;
+    }
+    bool found;
+    size_t i = hash_find(tab, key, hash_mix(tab, key), &found);
     // sorry boss!
-    return (void *)-1;
+    return found ? tab->buckets[i].val : (void *)-1;
 }
 
 void hash_insert(struct hash_table *tab, void *key, void *val) {
-    void **elt = NULL;
-    struct list *bucket = tab->buckets[HASH];
-    // check if it's already in the table
-    LFOREACH(struct bucket_entry *ent, bucket)
-        if (tab->comp(key, ent->key)) {
-            elt = &ent->val;
-        }
-    ENDLFOREACH;
+    if (tab->num_buckets == 0) {
+        hash_resize(tab, tab->initial_buckets);
+    } else if (tab->length + 1 > tab->num_buckets / 8 * 7) {
+        hash_resize(tab, tab->num_buckets * 2);
+    }
 
-    if (elt != NULL) {
-        tab->val_dtor(*elt);
-        *elt = val;
+    uint64_t h = hash_mix(tab, key);
+    bool found;
+    size_t i = hash_find(tab, key, h, &found);
+    if (found) {
+        tab->val_dtor(tab->buckets[i].val);
+        tab->buckets[i].val = val;
         return;
     }
-    // otherwise, insert a new bucket entry.
-    struct bucket_entry *b = M(struct bucket_entry);
-    b->key = key;
-    b->val = val;
-    list_add(bucket, b);
+    tab->ctrl[i] = H2(h);
+    tab->buckets[i].key = key;
+    tab->buckets[i].val = val;
+    tab->length++;
 }
 
 void hash_free(struct hash_table *tab) {
-    for (int j = 0; j < tab->num_buckets; j++) {
-        LFOREACH(struct bucket_entry *ent, tab->buckets[j])
-            tab->key_dtor(ent->key);
-            tab->val_dtor(ent->val);
-        ENDLFOREACH;
-        list_free(tab->buckets[j]);
-    }
+    HFOREACH(ent, tab)
+        tab->key_dtor(ent->key);
+        tab->val_dtor(ent->val);
+    ENDHFOREACH;
+    D(tab->ctrl);
     D(tab->buckets);
     D(tab);
 }
@@ -225,19 +394,249 @@ uint64_t hashpjw(char *string, size_t size) {
     return h;
 }
 
+/* the interner */
+
+#define INTERN_CHUNK_SIZE (1 << 16)
+
+struct intern_chunk {
+    struct intern_chunk *next;
+    size_t used, capacity;
+    char data[];
+};
+
+static __thread struct {
+    // the string arena. spellings never move once copied in.
+    struct intern_chunk *chunks;
+    // indexed by id. slot 0 is NO_IDENT.
+    char **strs;
+    uint32_t *lens;
+    uint64_t *hashes;
+    uint32_t next_id, capacity;
+    // open-addressed table of ids, keyed by spelling. 0 marks an empty slot.
+    uint32_t *slots;
+    uint32_t num_slots;
+} interner;
+
+static uint64_t hash_spelling(const char *s, size_t len) {
+    // FNV-1a. hashpjw leaves the low bits to the last couple of characters,
+    // which is exactly where generated names like x1, x2, ... differ.
+    uint64_t h = 0xcbf29ce484222325;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+
+static char *intern_copy(const char *s, size_t len) {
+    struct intern_chunk *c = interner.chunks;
+    if (!c || c->capacity - c->used < len + 1) {
+        size_t cap = len + 1 > INTERN_CHUNK_SIZE ? len + 1 : INTERN_CHUNK_SIZE;
+        c = malloc(sizeof(struct intern_chunk) + cap);
+        if (!c) abort();
+        c->next = interner.chunks;
+        c->used = 0;
+        c->capacity = cap;
+        interner.chunks = c;
+    }
+    char *dst = c->data + c->used;
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+    c->used += len + 1;
+    return dst;
+}
+
+static void intern_grow_slots(void) {
+    uint32_t n = interner.num_slots ? interner.num_slots * 2 : 1 << 8;
+    uint32_t *slots = calloc(n, sizeof(uint32_t));
+    if (!slots) abort();
+    for (uint32_t id = 1; id < interner.next_id; id++) {
+        uint32_t i = interner.hashes[id] & (n - 1);
+        while (slots[i]) i = (i + 1) & (n - 1);
+        slots[i] = id;
+    }
+    free(interner.slots);
+    interner.slots = slots;
+    interner.num_slots = n;
+}
+
+static void intern_grow_ids(void) {
+    uint32_t cap = interner.capacity ? interner.capacity * 2 : 1 << 8;
+    interner.strs = realloc(interner.strs, cap * sizeof(char *));
+    interner.lens = realloc(interner.lens, cap * sizeof(uint32_t));
+    interner.hashes = realloc(interner.hashes, cap * sizeof(uint64_t));
+    if (!interner.strs || !interner.lens || !interner.hashes) abort();
+    interner.capacity = cap;
+}
+
+ident intern(const char *s, size_t len) {
+    if (interner.next_id == 0) {
+        intern_grow_ids();
+        interner.strs[NO_IDENT] = "<none>";
+        interner.lens[NO_IDENT] = 0;
+        interner.hashes[NO_IDENT] = 0;
+        interner.next_id = 1;
+    }
+    // keep the load factor under 1/2.
+    if (interner.next_id * 2 >= interner.num_slots) {
+        intern_grow_slots();
+    }
+
+    uint64_t h = hash_spelling(s, len);
+    uint32_t mask = interner.num_slots - 1, i;
+    for (i = h & mask; interner.slots[i]; i = (i + 1) & mask) {
+        uint32_t id = interner.slots[i];
+        if (interner.hashes[id] == h && interner.lens[id] == len
+                && memcmp(interner.strs[id], s, len) == 0) {
+            return id;
+        }
+    }
+
+    if (interner.next_id == interner.capacity) {
+        intern_grow_ids();
+    }
+    ident id = interner.next_id++;
+    interner.strs[id] = intern_copy(s, len);
+    interner.lens[id] = len;
+    interner.hashes[id] = h;
+    interner.slots[i] = id;
+    return id;
+}
+
+ident intern_cstr(const char *s) {
+    return intern(s, strlen(s));
+}
+
+char *ident_str(ident id) {
+    assert(id < interner.next_id || id == NO_IDENT);
+    return id == NO_IDENT ? "<none>" : interner.strs[id];
+}
+
+size_t intern_count(void) {
+    return interner.next_id ? interner.next_id - 1 : 0;
+}
+
+void intern_free(void) {
+    struct intern_chunk *c = interner.chunks;
+    while (c) {
+        struct intern_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(interner.strs);
+    free(interner.lens);
+    free(interner.hashes);
+    free(interner.slots);
+    memset(&interner, 0, sizeof(interner));
+}
+
+__thread struct source *current_source = NULL;
+__thread jmp_buf *current_bailout = NULL;
+
+void source_init(struct source *src, const char *text, size_t len) {
+    memset(src, 0, sizeof(*src));
+    src->text = text;
+    src->len = len;
+}
+
+static void source_index(struct source *src) {
+    size_t cap = 64, n = 0;
+    uint32_t *starts = malloc(cap * sizeof(*starts));
+    if (!starts) abort();
+    starts[n++] = 0;
+
+    const char *text = src->text;
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; src->len - i >= 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (text + i));
+        uint32_t m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        if (!m) continue;
+        if (n + 16 > cap) {
+            cap *= 2;
+            starts = realloc(starts, cap * sizeof(*starts));
+            if (!starts) abort();
+        }
+        for (; m; m &= m - 1) {
+            starts[n++] = i + __builtin_ctz(m) + 1;
+        }
+    }
+#endif
+    for (; i < src->len; i++) {
+        if (text[i] != '\n') continue;
+        if (n == cap) {
+            cap *= 2;
+            starts = realloc(starts, cap * sizeof(*starts));
+            if (!starts) abort();
+        }
+        starts[n++] = i + 1;
+    }
+
+    src->line_starts = starts;
+    src->num_lines = n;
+}
+
+// 1-based line and column of the byte at offset, or 0 and 0 without a source.
+void source_pos(struct source *src, uint32_t offset, int *line, int *col) {
+    if (!src) {
+        *line = *col = 0;
+        return;
+    }
+    if (!src->line_starts) source_index(src);
+
+    // the last line starting at or before offset.
+    size_t lo = 0, hi = src->num_lines;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (src->line_starts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    *line = lo + 1;
+    *col = offset - src->line_starts[lo] + 1;
+}
+
+void source_free(struct source *src) {
+    free(src->line_starts);
+    memset(src, 0, sizeof(*src));
+}
+
+static void print_loc(YYLTYPE *loc) {
+    if (!current_source) return;
+    if (current_source->name) fprintf(stderr, "%s: ", current_source->name);
+    if (!loc) return;
+    int line, col;
+    source_pos(current_source, loc->offset, &line, &col);
+    fprintf(stderr, "line %d, column %d: ", line, col);
+}
+
+// one message per call, even with other threads printing theirs.
+static void vdiag(char *fmt, YYLTYPE *loc, va_list args) {
+    flockfile(stderr);
+    print_loc(loc);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+}
+
 void span_err(char *fmt, YYLTYPE *loc, ...) {
     va_list args;
     va_start(args, loc);
-    vfprintf(stderr, fmt, args);
-    fputc('\n', stderr);
+    vdiag(fmt, loc, args);
+    va_end(args);
+    // no need to unwind: compile_input releases everything the compile
+    // allocated in one go.
+    if (current_bailout) longjmp(*current_bailout, 1);
     exit(1);
 }
 
 void span_diag(char *fmt, YYLTYPE *loc, ...) {
     va_list args;
     va_start(args, loc);
-    vfprintf(stderr, fmt, args);
-    fputc('\n', stderr);
+    vdiag(fmt, loc, args);
+    va_end(args);
 }
 
 void dummy_free(void *unused) {
@@ -4,9 +4,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <setjmp.h>
 
-#define M(ty) ((ty*)calloc(1, sizeof(ty)))
-#define D(ptr) (free(ptr))
+#define M(ty) ((ty*)xcalloc(sizeof(ty)))
+#define D(ptr) (xfree(ptr))
 #define YOLO (void*)
 #define CB (void (*)(void*))
 
@@ -49,6 +50,30 @@
 
 #define ENDLFOREACHREV } } while(0)
 
+/* Region allocator. Memory is carved out of large chunks and never freed
+ * individually; arena_reset releases all of it at once. */
+struct arena_chunk;
+
+struct arena {
+    struct arena_chunk *head;
+    // statistics, for the curious.
+    size_t allocs, bytes, chunks;
+};
+
+void arena_init(struct arena *);
+void *arena_alloc(struct arena *, size_t);
+void *arena_realloc(struct arena *, void *, size_t, size_t);
+void arena_reset(struct arena *);
+
+/* While current_arena is set, M(), D() and the containers below allocate from
+ * it and D() does nothing; otherwise they use the C heap. Like all of the
+ * current_* state it is per-thread, so each thread can run its own compile. */
+extern __thread struct arena *current_arena;
+
+void *xcalloc(size_t);
+void *xrealloc(void *, size_t, size_t);
+void xfree(void *);
+
 typedef uint64_t (*HASH_FUNC)(void *);
 typedef bool (*COMPARE_FUNC)(void *, void *);
 typedef void (*FREE_FUNC)(void *);
@@ -88,27 +113,40 @@ void *ptrvec_last(struct ptrvec *);
 void ptrvec_free(struct ptrvec *);
 struct ptrvec *ptrvec_new(FREE_FUNC, size_t, ...);
 
-/* Super simple, crappy chained hash table. */
+/* Open-addressing hash table in the style of a Swiss table. Alongside the
+ * slots is an array of control bytes, one per slot: either HASH_CTRL_EMPTY or
+ * the top 7 bits of the key's hash. Probing loads a group of 16 control bytes
+ * and compares them all at once (with SSE2 where available), so most misses
+ * and hits never touch a key. There is no removal, so there are no
+ * tombstones. Nothing is allocated until the first insert. */
+#define HASH_GROUP_SIZE 16
+#define HASH_CTRL_EMPTY 0x80
+
+struct bucket_entry {
+    void *key;
+    void *val;
+};
+
 struct hash_table {
-    // number of buckets
+    // number of slots: 0, or a power of two no smaller than HASH_GROUP_SIZE
     size_t num_buckets;
+    // number of occupied slots
+    size_t length;
+    // slots to allocate on the first insert
+    size_t initial_buckets;
     HASH_FUNC hash;
     COMPARE_FUNC comp;
     FREE_FUNC key_dtor, val_dtor;
-    struct list **buckets;
-};
-
-struct bucket_entry {
-    void *key;
-    void *val;
+    uint8_t *ctrl;
+    struct bucket_entry *buckets;
 };
 
 #define HFOREACH(name, hm) do { \
-    int __hi; struct list *__bucket; \
-    for (__hi = 0, __bucket = hm->buckets[0]; __hi < hm->num_buckets; __bucket = hm->buckets[__hi++]) {\
-    LFOREACH(struct bucket_entry *name, __bucket)
+    for (size_t __hi = 0; __hi < (hm)->num_buckets; __hi++) {\
+        if ((hm)->ctrl[__hi] & HASH_CTRL_EMPTY) continue;\
+        struct bucket_entry *name = &(hm)->buckets[__hi];
 
-#define ENDHFOREACH ENDLFOREACH; } } while (0)
+#define ENDHFOREACH } } while (0)
 
 struct hash_table *hash_new(size_t, HASH_FUNC, COMPARE_FUNC, FREE_FUNC, FREE_FUNC);
 void *hash_lookup(struct hash_table *, void *);
@@ -116,12 +154,50 @@ void hash_insert(struct hash_table *, void *, void *);
 void hash_free(struct hash_table *);
 uint64_t hashpjw(char *, size_t);
 uint64_t hash_pointer(void *);
+uint64_t hash_ident(void *);
 bool compare_pointer(void *, void *);
 
+/* Per-thread identifier interner. Each distinct spelling is copied once into a
+ * string arena and named by a dense 32-bit id, so names compare with == and
+ * key hash tables directly. Id 0 is never handed out: it means "no name", and
+ * keeps ids non-NULL when they are stored in a list as pointers. */
+typedef uint32_t ident;
+
+#define NO_IDENT 0
+#define IDENT_P(id) ((void *)(uintptr_t)(id))
+#define P_IDENT(p) ((ident)(uintptr_t)(p))
+
+ident intern(const char *, size_t);
+ident intern_cstr(const char *);
+char *ident_str(ident);
+size_t intern_count(void);
+void intern_free(void);
+
 /* compiler-specific stuff, remove if copying */
 
 struct YYLTYPE;
 
+/* The source being compiled, for turning token offsets back into lines and
+ * columns. The table of line starts is only built on the first lookup, so a
+ * compile that prints no diagnostics never scans for newlines. */
+struct source {
+    const char *text;
+    size_t len;
+    const char *name; // prefixed to diagnostics when set
+    uint32_t *line_starts; // offset of the first byte of each line
+    size_t num_lines;
+};
+
+extern __thread struct source *current_source;
+
+/* Where span_err jumps once it has printed its message. compile_input sets
+ * it, so an error abandons only the compile that raised it. */
+extern __thread jmp_buf *current_bailout;
+
+void source_init(struct source *, const char *text, size_t len);
+void source_pos(struct source *, uint32_t offset, int *line, int *col);
+void source_free(struct source *);
+
 void span_err(char *fmt, struct YYLTYPE *loc, ...);
 void span_diag(char *fmt, struct YYLTYPE *loc, ...);
 void dummy_free(void *);